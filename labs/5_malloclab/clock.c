@@ -10,18 +10,26 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/times.h>
+#include <time.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#endif
 #include "clock.h"
 
+#ifndef CLOCK_MONOTONIC_RAW
+#define CLOCK_MONOTONIC_RAW CLOCK_MONOTONIC
+#endif
+
 
 /******************************************************* 
  * Machine dependent functions 
  *
- * Note: the constants __i386__ and  __alpha
+ * Note: the constants __i386__, __x86_64__, and __alpha
  * are set by GCC when it calls the C preprocessor
  * You can verify this for yourself using gcc -v.
  *******************************************************/
 
-#if defined(__i386__)  
+#if defined(__i386__) || defined(__x86_64__)
 /*******************************************************
  * Pentium versions of start_counter() and get_counter()
  *******************************************************/
@@ -71,6 +79,29 @@ double get_counter()
 }
 /* $end x86cyclecounter */
 
+/* Return the raw 64-bit value of the cycle counter */
+unsigned long long read_counter()
+{
+    unsigned hi, lo;
+
+    access_counter(&hi, &lo);
+    return ((unsigned long long)hi << 32) | lo;
+}
+
+/* 
+ * Does the time stamp counter tick at a constant rate, whatever the
+ * power state of the core?  (CPUID leaf 0x80000007, EDX bit 8)
+ */
+static int invariant_counter()
+{
+    unsigned a, b, c, d;
+
+    if (__get_cpuid_max(0x80000000, NULL) < 0x80000007)
+	return 0;
+    __cpuid(0x80000007, a, b, c, d);
+    return (d >> 8) & 1;
+}
+
 #elif defined(__alpha)
 
 /****************************************************
@@ -133,6 +164,12 @@ double get_counter()
     return result;
 }
 
+/* Return the raw value of the (32-bit) cycle counter */
+unsigned long long read_counter()
+{
+    return counter();
+}
+
 #else
 
 /****************************************************************
@@ -158,6 +195,23 @@ double get_counter()
     printf("Please choose another timing package in config.h.\n");
     exit(1);
 }
+
+/* Without a cycle counter, count nanoseconds of a monotonic clock */
+unsigned long long read_counter()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#endif
+
+#if !defined(__i386__) && !defined(__x86_64__)
+/* No way to tell whether the counter rate is constant */
+static int invariant_counter()
+{
+    return 0;
+}
 #endif
 
 
@@ -179,26 +233,104 @@ double ovhd()
     return result;
 }
 
+/* Read CLOCK_MONOTONIC_RAW, which NTP does not slew, in seconds */
+static double raw_secs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
 /* $begin mhz */
 /* Estimate the clock rate by measuring the cycles that elapse */ 
-/* while sleeping for sleeptime seconds */
+/* while sleeping for sleeptime seconds, as timed by the raw clock */
 double mhz_full(int verbose, int sleeptime)
 {
-    double rate;
+    double rate, t0;
 
+    t0 = raw_secs();
     start_counter();
     sleep(sleeptime);
-    rate = get_counter() / (1e6*sleeptime);
+    rate = get_counter() / (1e6*(raw_secs() - t0));
     if (verbose) 
 	printf("Processor clock rate ~= %.1f MHz\n", rate);
     return rate;
 }
 /* $end mhz */
 
-/* Version using a default sleeptime */
+#define CAL_ROUNDS 5        /* calibration windows; the median is kept */
+#define CAL_SECS   0.005    /* length of each window */
+
+/* 
+ * Estimate the counter rate against the raw clock, over CAL_ROUNDS
+ * short busy-waiting windows.  The median discards windows that a
+ * context switch or migration disturbed.
+ */
+static double calibrate(int verbose)
+{
+    double rate[CAL_ROUNDS], t0, t, tmp;
+    unsigned long long c0;
+    int i, j;
+
+    for (i = 0; i < CAL_ROUNDS; i++) {
+	t0 = raw_secs();
+	c0 = read_counter();
+	while ((t = raw_secs()) - t0 < CAL_SECS)
+	    ;
+	rate[i] = (read_counter() - c0) / (t - t0);
+	for (j = i; j > 0 && rate[j-1] > rate[j]; j--) {
+	    tmp = rate[j-1];
+	    rate[j-1] = rate[j];
+	    rate[j] = tmp;
+	}
+    }
+    if (verbose) 
+	printf("Processor clock rate ~= %.1f MHz\n", rate[CAL_ROUNDS/2] / 1e6);
+    return rate[CAL_ROUNDS/2];
+}
+
+/* Version calibrated against the raw clock in a few milliseconds */
 double mhz(int verbose)
 {
-    return mhz_full(verbose, 2);
+    return calibrate(verbose) / 1e6;
+}
+
+/** A monotonic clock in seconds for timing whole runs */
+
+static int clock_state = 0;     /* 0: not chosen, 1: counter, 2: raw clock */
+static double counter_hz;
+static unsigned long long counter_base;
+
+/* Pick the clock: the counter if its rate is invariant, else raw */
+static void choose_clock(int verbose)
+{
+    if (invariant_counter()) {
+	counter_hz = calibrate(verbose);
+	counter_base = read_counter();
+	clock_state = 1;
+    }
+    else
+	clock_state = 2;
+}
+
+/* Seconds since some fixed point in the past */
+double clock_secs()
+{
+    if (clock_state == 0)
+	choose_clock(0);
+    if (clock_state == 1)
+	return (read_counter() - counter_base) / counter_hz;
+    return raw_secs();
+}
+
+/* Describe the clock that clock_secs reads */
+char *clock_source(int verbose)
+{
+    if (clock_state == 0)
+	choose_clock(verbose);
+    return (clock_state == 1) ? "the invariant cycle counter" 
+	: "CLOCK_MONOTONIC_RAW";
 }
 
 /** Special counters that compensate for timer interrupt overhead */
@@ -6,10 +6,13 @@ void start_counter();
 /* Get # cycles since counter started */
 double get_counter();
 
+/* Read the raw counter, for timing many short events cheaply */
+unsigned long long read_counter();
+
 /* Measure overhead for counter */
 double ovhd();
 
-/* Determine clock rate of processor (using a default sleeptime) */
+/* Determine clock rate of processor (calibrated against the raw clock) */
 double mhz(int verbose);
 
 /* Determine clock rate of processor, having more control over accuracy */
@@ -20,3 +23,13 @@ double mhz_full(int verbose, int sleeptime);
 void start_comp_counter();
 
 double get_comp_counter();
+
+/** A monotonic clock for timing whole runs: the cycle counter, scaled
+    by its calibrated rate, where that rate is invariant; otherwise
+    CLOCK_MONOTONIC_RAW */
+
+/* Seconds since some fixed point in the past */
+double clock_secs();
+
+/* Describe the clock that clock_secs reads (calibrating it if need be) */
+char *clock_source(int verbose);
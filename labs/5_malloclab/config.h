@@ -18,8 +18,8 @@
  * This is the list of default tracefiles in TRACEDIR that the driver
  * will use for testing. Modify this if you want to add or delete
  * traces from the driver's test suite. For example, if you don't want
- * your students to implement realloc, you can delete the last two
- * traces.
+ * your students to implement realloc, you can delete the two realloc
+ * traces, and without mm_memalign the last one.
  */
 #define DEFAULT_TRACEFILES \
   "amptjp-bal.rep",\
@@ -32,7 +32,8 @@
   "binary-bal.rep",\
   "binary2-bal.rep",\
   "realloc-bal.rep",\
-  "realloc2-bal.rep"
+  "realloc2-bal.rep",\
+  "memalign-bal.rep"
 
 /*
  * This constant gives the estimated performance of the libc malloc
@@ -58,15 +59,39 @@
 #define ALIGNMENT 8  
 
 /* 
- * Maximum heap size in bytes 
+ * Maximum heap size in bytes (libmm.so builds with a larger one)
  */
+#ifndef MAX_HEAP
 #define MAX_HEAP (20*(1<<20))  /* 20 MB */
+#endif
+
+/*
+ * Set to 1 for mm.c to keep its block headers, footers, and free-list
+ * links in 4-byte words, which can only describe a heap under 4 GB,
+ * or to 0 for 8-byte words.  By default it follows MAX_HEAP.
+ */
+#ifndef MM_COMPACT
+#if MAX_HEAP < 0xffffffff
+#define MM_COMPACT 1
+#else
+#define MM_COMPACT 0
+#endif
+#endif
+
+/*
+ * Default size in bytes from which the allocator serves a request
+ * with a mem_map region of its own instead of heap space. You can
+ * override it at runtime with the driver's -m flag.
+ */
+#define MMAP_THRESHOLD (128*(1<<10))  /* 128 KB */
 
 /*****************************************************************************
  * Set exactly one of these USE_xxx constants to "1" to select a timing method
  *****************************************************************************/
 #define USE_FCYC   0   /* cycle counter w/K-best scheme (x86 & Alpha only) */
-#define USE_ITIMER 1   /* interval timer (any Unix box) */
+#define USE_ITIMER 0   /* interval timer (any Unix box) */
 #define USE_GETTOD 0   /* gettimeofday (any Unix box) */
+#define USE_CLOCK  1   /* invariant cycle counter or CLOCK_MONOTONIC_RAW, 
+			  with confidence intervals (any POSIX box) */
 
 #endif /* __CONFIG_H */
@@ -9,6 +9,7 @@
 #include "config.h"
 
 static double Mhz;  /* estimated CPU clock frequency */
+static double ci;   /* 95% confidence half-width of the last fsecs */
 
 extern int verbose; /* -v option in mdriver.c */
 
@@ -36,6 +37,12 @@ void init_fsecs(void)
 #elif USE_GETTOD
     if (verbose)
 	printf("Measuring performance with gettimeofday().\n");
+#elif USE_CLOCK
+    {
+	char *source = clock_source(verbose > 0);
+	if (verbose)
+	    printf("Measuring performance with %s.\n", source);
+    }
 #endif
 }
 
@@ -51,7 +58,18 @@ double fsecs(fsecs_test_funct f, void *argp)
     return ftimer_itimer(f, argp, 10);
 #elif USE_GETTOD
     return ftimer_gettod(f, argp, 10);
+#elif USE_CLOCK
+    return ftimer_clock(f, argp, 10, &ci);
 #endif 
 }
 
+/*
+ * fsecs_ci - Return the half-width of the 95% confidence interval of
+ *     the last fsecs result, or 0 if the timing method does not give one
+ */
+double fsecs_ci(void)
+{
+    return ci;
+}
+
 
@@ -7,10 +7,16 @@
  * Function timers that estimate the running time (in seconds) of a function f.
  *    ftimer_itimer: version that uses the interval timer
  *    ftimer_gettod: version that uses gettimeofday
+ *    ftimer_clock: version that uses clock_secs, with a confidence interval
  */
 #include <stdio.h>
+#include <math.h>
 #include <sys/time.h>
 #include "ftimer.h"
+#include "clock.h"
+
+#define CLOCK_MIN_SECS 0.1   /* ftimer_clock keeps going this long... */
+#define CLOCK_MAX_RUNS 1000  /* ...up to this many runs */
 
 /* function prototypes */
 static void init_etime(void);
@@ -52,6 +58,43 @@ double ftimer_gettod(ftimer_test_funct f, void *argp, int n)
     return (1E-3*diff);
 }
 
+/* 
+ * ftimer_clock - Use clock_secs to time each of at least n runs of
+ * f(argp), and more if they all fit in CLOCK_MIN_SECS.  Return the mean
+ * running time, and set *ci to the half-width of its 95% confidence
+ * interval (Student's t, since there may be few runs).
+ */
+double ftimer_clock(ftimer_test_funct f, void *argp, int n, double *ci)
+{
+    /* t(0.975, df) for df = 1..30; above that the normal 1.96 will do */
+    static double t975[] = {
+	12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262,
+	2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101,
+	2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052,
+	2.048, 2.045, 2.042
+    };
+    double start, t, sum = 0, sumsq = 0, mean, var;
+    int i;
+
+    for (i = 0; i < CLOCK_MAX_RUNS && (i < n || sum < CLOCK_MIN_SECS); i++) {
+	start = clock_secs();
+	f(argp);
+	t = clock_secs() - start;
+	sum += t;
+	sumsq += t*t;
+    }
+    mean = sum / i;
+    if (i < 2) {
+	*ci = 0;
+	return mean;
+    }
+    var = (sumsq - sum*mean) / (i - 1);
+    if (var < 0)      /* rounding */
+	var = 0;
+    *ci = (i - 1 <= 30 ? t975[i - 2] : 1.96) * sqrt(var / i);
+    return mean;
+}
+
 
 /*
  * Routines for manipulating the Unix interval timer
@@ -12,3 +12,8 @@ double ftimer_itimer(ftimer_test_funct f, void *argp, int n);
    Return the average of n runs */
 double ftimer_gettod(ftimer_test_funct f, void *argp, int n);
 
+/* Estimate the running time of f(argp) using clock_secs in clock.c.
+   Return the mean of at least n runs, and in *ci the half-width of
+   its 95% confidence interval */
+double ftimer_clock(ftimer_test_funct f, void *argp, int n, double *ci);
+
@@ -0,0 +1,145 @@
+/*
+ * hist.c - Log-linear histograms of latencies.
+ *
+ * Bucket i holds values whose top HIST_SUB_BITS+1 significant bits
+ * select it: group i / HIST_SUB is the power of two (0 for values
+ * below HIST_SUB) and i % HIST_SUB the slice of it.  Percentiles are
+ * reported as the highest value of the bucket they fall in, as
+ * HdrHistogram does, capped at the largest value recorded.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "hist.h"
+
+static int bucket_of(unsigned long long v);
+static unsigned long long bucket_hi(int i);
+
+/*
+ * hist_reset - Empty histogram h
+ */
+void hist_reset(hist_t *h)
+{
+    memset(h, 0, sizeof(*h));
+}
+
+/*
+ * hist_record - Add value v to histogram h
+ */
+void hist_record(hist_t *h, unsigned long long v)
+{
+    h->buckets[bucket_of(v)]++;
+    h->count++;
+    h->sum += v;
+    if (v > h->max)
+	h->max = v;
+}
+
+/*
+ * hist_merge - Add every value in histogram src to histogram dst
+ */
+void hist_merge(hist_t *dst, hist_t *src)
+{
+    int i;
+
+    for (i = 0; i < HIST_BUCKETS; i++)
+	dst->buckets[i] += src->buckets[i];
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->max > dst->max)
+	dst->max = src->max;
+}
+
+/*
+ * hist_percentile - Return the value at percentile pct (0..100) of h,
+ *     or 0 if h is empty
+ */
+unsigned long long hist_percentile(hist_t *h, double pct)
+{
+    unsigned long long rank, seen = 0;
+    int i;
+
+    if (h->count == 0)
+	return 0;
+    rank = (unsigned long long)ceil(pct / 100.0 * h->count);
+    if (rank < 1)
+	rank = 1;
+    for (i = 0; i < HIST_BUCKETS; i++) {
+	seen += h->buckets[i];
+	if (seen >= rank)
+	    break;
+    }
+    return (bucket_hi(i) < h->max) ? bucket_hi(i) : h->max;
+}
+
+/*
+ * hist_print - Write h to fp as a percentile distribution in the text
+ *     format of HdrHistogram, one line per nonempty bucket, headed by
+ *     a comment line holding title
+ */
+void hist_print(FILE *fp, hist_t *h, char *title)
+{
+    unsigned long long seen = 0, v;
+    double pct, sq = 0, mean;
+    int i;
+
+    fprintf(fp, "# %s\n", title);
+    fprintf(fp, "%12s %14s %10s %14s\n\n", 
+	    "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+    if (h->count == 0) {
+	fprintf(fp, "#[Total count    = %12d]\n\n", 0);
+	return;
+    }
+
+    mean = h->sum / h->count;
+    for (i = 0; i < HIST_BUCKETS; i++) {
+	if (h->buckets[i] == 0)
+	    continue;
+	seen += h->buckets[i];
+	v = (bucket_hi(i) < h->max) ? bucket_hi(i) : h->max;
+	sq += h->buckets[i] * ((double)v - mean) * ((double)v - mean);
+	pct = (double)seen / h->count;
+	if (seen < h->count)
+	    fprintf(fp, "%12.3f %14.12f %10llu %14.2f\n", 
+		    (double)v, pct, seen, 1 / (1 - pct));
+	else
+	    fprintf(fp, "%12.3f %14.12f %10llu\n", (double)v, pct, seen);
+    }
+    fprintf(fp, "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n", 
+	    mean, sqrt(sq / h->count));
+    fprintf(fp, "#[Max     = %12.3f, Total count    = %12llu]\n", 
+	    (double)h->max, h->count);
+    fprintf(fp, "#[Buckets = %12d, SubBuckets     = %12d]\n\n", 
+	    HIST_BUCKETS, HIST_SUB);
+}
+
+/*
+ * The remaining routines are internal helper routines
+ */
+
+/*
+ * bucket_of - Return the index of the bucket that holds value v
+ */
+static int bucket_of(unsigned long long v)
+{
+    int m;
+
+    if (v < HIST_SUB)
+	return v;
+    m = 63 - __builtin_clzll(v);             /* v's highest set bit */
+    return (m - HIST_SUB_BITS + 1) * HIST_SUB +
+	(int)((v >> (m - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+/*
+ * bucket_hi - Return the largest value that falls in bucket i
+ */
+static unsigned long long bucket_hi(int i)
+{
+    int g = i / HIST_SUB, sub = i % HIST_SUB;
+
+    if (g == 0)
+	return sub;
+    return (((unsigned long long)(HIST_SUB + sub + 1)) << (g - 1)) - 1;
+}
@@ -0,0 +1,32 @@
+/*
+ * hist.h - Log-linear histograms of latencies, in the style of
+ *     HdrHistogram.
+ *
+ * Values below HIST_SUB get a bucket each.  Above that, every power of
+ * two is split into HIST_SUB equal buckets, so a value is known to
+ * within 1/HIST_SUB (about 3%) of itself at any magnitude, and every
+ * 64-bit value has a bucket.
+ */
+#ifndef __HIST_H_
+#define __HIST_H_
+
+#include <stdio.h>
+
+#define HIST_SUB_BITS 5
+#define HIST_SUB      (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS  ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+typedef struct {
+    unsigned long long count;     /* number of values recorded */
+    unsigned long long max;       /* largest value recorded */
+    double sum;                   /* sum of the values, for the mean */
+    unsigned long long buckets[HIST_BUCKETS];
+} hist_t;
+
+void hist_reset(hist_t *h);
+void hist_record(hist_t *h, unsigned long long v);
+void hist_merge(hist_t *dst, hist_t *src);
+unsigned long long hist_percentile(hist_t *h, double pct);
+void hist_print(FILE *fp, hist_t *h, char *title);
+
+#endif /* __HIST_H_ */
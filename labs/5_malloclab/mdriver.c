@@ -14,11 +14,26 @@
 #include <string.h>
 #include <assert.h>
 #include <float.h>
+#include <limits.h>
+#include <math.h>
 #include <time.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 
 #include "mm.h"
+#include "mm_mt.h"
 #include "memlib.h"
+#include "slab.h"
+#include "region.h"
 #include "fsecs.h"
+#include "clock.h"
+#include "perfctr.h"
+#include "hist.h"
+#include "tracefmt.h"
 #include "config.h"
 
 /**********************
@@ -29,10 +44,22 @@
 #define MAXLINE     1024 /* max string size */
 #define HDRLINES       4 /* number of header lines in a trace file */
 #define LINENUM(i) (i+5) /* cnvt trace request nums to linenums (origin 1) */
+#define RSS_SAMPLE   256 /* ops between resident set samples in eval_mm_util */
+#define MT_OPS   1000000 /* ops per thread per threaded replay, at least */
+#define LAT_OPS   200000 /* ops timed per trace in latency mode, at least */
+#define PERF_REPS       3 /* runs per trace under the hardware counters */
+#define REGION_REQ (64*(1<<10)) /* bytes allocated per request with -R */
+#define REGRESS_PCT     5 /* default -r: slowdown or util loss to flag */
+#define SERIES_FILE "heapinfo.csv" /* default -S: heap time series file */
 
 /* Returns true if p is ALIGNMENT-byte aligned */
 #define IS_ALIGNED(p)  ((((unsigned long)(p)) % ALIGNMENT) == 0)
 
+/* Height of a possibly empty range subtree */
+#define HEIGHT(t)      ((t) == NULL ? 0 : (t)->height)
+#define MAX(x, y)      ((x) > (y) ? (x) : (y))
+#define MIN(x, y)      ((x) < (y) ? (x) : (y))
+
 /****************************** 
  * The key compound data types 
  *****************************/
@@ -41,16 +68,11 @@
 typedef struct range_t {
     char *lo;              /* low payload address */
     char *hi;              /* high payload address */
-    struct range_t *next;  /* next list element */
+    struct range_t *left;  /* ranges at lower addresses */
+    struct range_t *right; /* ranges at higher addresses */
+    int height;            /* height of the subtree rooted here */
 } range_t;
 
-/* Characterizes a single trace operation (allocator request) */
-typedef struct {
-    enum {ALLOC, FREE, REALLOC} type; /* type of request */
-    int index;                        /* index for free() to use later */
-    int size;                         /* byte size of alloc/realloc request */
-} traceop_t;
-
 /* Holds the information for one trace file*/
 typedef struct {
     int sugg_heapsize;   /* suggested heap size (unused) */
@@ -60,6 +82,8 @@ typedef struct {
     traceop_t *ops;      /* array of requests */
     char **blocks;       /* array of ptrs returned by malloc/realloc... */
     size_t *block_sizes; /* ... and a corresponding array of payload sizes */
+    void *map;           /* mapped binary trace file, or NULL */
+    size_t map_len;      /* length of the mapping */
 } trace_t;
 
 /* 
@@ -78,23 +102,77 @@ typedef struct {
     double ops;      /* number of ops (malloc/free/realloc) in the trace */
     int valid;       /* was the trace processed correctly by the allocator? */
     double secs;     /* number of secs needed to run the trace */
+    double ci;       /* 95% confidence half-width of secs, or 0 if unknown */
 
     /* defined only for the student malloc package */
     double util;     /* space utilization for this trace (always 0 for libc) */
+    double ifrag;    /* internal fragmentation at peak, as a fraction of heap */
+    double slab;     /* fraction of the heap held in slab pages */
+    double heap_peak;/* most bytes in the heap and mem_map regions at once */
+    double rss_peak; /* most heap bytes resident at once */
+    double rss_end;  /* heap bytes still resident at the end of the trace */
+    mm_realloc_stats_t realloc; /* which mm_realloc paths the trace took */
+    perf_counts_t perf; /* hardware counters over one speed run (-C) */
 
     /* Note: secs and util are only defined if valid is true */
 } stats_t; 
 
+/* Summarizes a threaded replay of one trace through mm_mt.c */
+typedef struct {
+    int ok;          /* did every thread finish without running out? */
+    double kops1;    /* aggregate Kops/s with one thread */
+    double kops;     /* aggregate Kops/s with all threads */
+    double *thread;  /* Kops/s of each thread in the second run */
+} mtstats_t;
+
+/* Compares the two ways of releasing each request's blocks (-R) */
+typedef struct {
+    int ok;          /* did both replays fit in the heap? */
+    int reqs;        /* requests the trace was cut into */
+    double ops;      /* ops in the trace */
+    double secs_free;   /* secs to replay it, freeing each block by itself */
+    double secs_region; /* ... and releasing them with region_reset */
+    double region_peak; /* most bytes a region held from mm_malloc */
+} regstats_t;
+
+/* The arguments and results of one request replay */
+typedef struct {
+    trace_t *trace;  /* trace to replay */
+    int region;      /* allocate from a region instead of mm_malloc */
+    int *live;       /* ids allocated in the current request */
+    int ok;          /* was every request satisfied? */
+    int reqs;        /* requests replayed */
+    size_t peak;     /* most bytes the region held */
+} regarg_t;
+
+/* The arguments and results of one replay thread */
+typedef struct {
+    trace_t *trace;            /* trace to replay */
+    int id;                    /* this thread's number */
+    int nthreads;              /* number of threads replaying the trace */
+    int partition;             /* replay only the blocks with index % n == id */
+    int reps;                  /* times to replay the trace */
+    pthread_barrier_t *start;  /* released when every thread is ready */
+    double ops;                /* ops this thread performed */
+    double secs;               /* how long this thread took */
+    int ok;                    /* did mm_mt satisfy every request? */
+} mtarg_t;
+
 /********************
  * Global variables
  *******************/
 int verbose = 0;        /* global flag for verbose output */
 static int errors = 0;  /* number of errs found when running student malloc */
+static int series_ops = 0; /* if set, sample mm_heapinfo this often (-s) */
+static int series_fd = -1; /* ... into this file, shared by the workers */
 char msg[MAXLINE];      /* for whenever we need to compose an error message */
 
 /* Directory where default tracefiles are found */
 static char tracedir[MAXLINE] = TRACEDIR;
 
+/* What -p calls each kind of heap page, indexed by MEM_PAGES_xxx */
+static char *page_kinds[] = {"base", "thp", "hugetlb"};
+
 /* The filenames of the default tracefiles */
 static char *default_tracefiles[] = {  
     DEFAULT_TRACEFILES, NULL
@@ -105,16 +183,31 @@ static char *default_tracefiles[] = {
  * Function prototypes 
  *********************/
 
-/* these functions manipulate range lists */
+/* these functions manipulate range trees */
 static int add_range(range_t **ranges, char *lo, int size, 
 		     int tracenum, int opnum);
 static void remove_range(range_t **ranges, char *lo);
 static void clear_ranges(range_t **ranges);
+static range_t *find_range(range_t *t, char *addr);
+static range_t *rotate(range_t *t, int dir);
+static range_t *rebalance(range_t *t);
+static range_t *insert_range(range_t *t, range_t *p);
+static range_t *delete_range(range_t *t, char *lo);
 
 /* These functions read, allocate, and free storage for traces */
 static trace_t *read_trace(char *tracedir, char *filename);
+static void map_trace(trace_t *trace, FILE *tracefile, char *path);
 static void free_trace(trace_t *trace);
 
+/* Routines for evaluating each trace, in forked workers if asked */
+static void eval_traces(int n, char **tracefiles, int jobs, int libc,
+			stats_t *stats, hist_t *hists, int counters);
+static void eval_libc_trace(int i, char *tracefile, stats_t *stats);
+static void eval_mm_trace(int i, char *tracefile, stats_t *stats,
+			  hist_t *hists, int counters);
+static int read_all(int fd, void *buf, size_t len);
+static void write_all(int fd, void *buf, size_t len);
+
 /* Routines for evaluating the correctness and speed of libc malloc */
 static int eval_libc_valid(trace_t *trace, int tracenum);
 static void eval_libc_speed(void *ptr);
@@ -122,11 +215,45 @@ static void eval_libc_speed(void *ptr);
 /* Routines for evaluating correctnes, space utilization, and speed 
    of the student's malloc package in mm.c */
 static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges);
-static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges);
+static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges,
+			   stats_t *stats);
 static void eval_mm_speed(void *ptr);
+static void sample_heap(FILE *fp, int tracenum, int opnum, size_t payload);
+static void open_series(char *file);
+
+/* Routines for replaying a trace on several threads through mm_mt.c */
+static void eval_mm_mt(trace_t *trace, int nthreads, int partition,
+		       mtstats_t *stats);
+static double mt_run(trace_t *trace, int nthreads, int partition, int reps,
+		     double *thread, int *ok);
+static void *mt_replay(void *ptr);
+static void mt_check(void);
+static double wall_secs(void);
+
+/* Region release versus per-object mm_free (-R) */
+static void eval_mm_region(trace_t *trace, regstats_t *stats);
+static void region_replay(void *ptr);
+
+/* Routines for timing every request of a trace */
+static void eval_mm_latency(trace_t *trace, hist_t *hists);
+static unsigned long long counter_ovhd(void);
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats);
+static void printreallocs(int n, stats_t *stats);
+static void printfrag(int n, stats_t *stats);
+static void printmt(int n, mtstats_t *stats, int nthreads, int partition);
+static void printregion(int n, regstats_t *stats);
+static void printlatency(int n, hist_t *hists, char **tracefiles, 
+			 char *histfile);
+static void printperf(int n, stats_t *stats);
+static void printpages(int n, stats_t *base, stats_t *stats, int kind,
+		       int counters);
+static void printchange(double base, double val, int valid, char *fmt);
+static void write_results(char *file, int n, char **tracefiles, 
+			  stats_t *stats, hist_t *hists);
+static int compare_baseline(char *file, int n, char **tracefiles,
+			    stats_t *stats, double pct);
 static void usage(void);
 static void unix_error(char *msg);
 static void malloc_error(int tracenum, int opnum, char *msg);
@@ -142,13 +269,29 @@ int main(int argc, char **argv)
     char **tracefiles = NULL;  /* null-terminated array of trace file names */
     int num_tracefiles = 0;    /* the number of traces in that array */
     trace_t *trace = NULL;     /* stores a single trace file in memory */
-    range_t *ranges = NULL;    /* keeps track of block extents for one trace */
     stats_t *libc_stats = NULL;/* libc stats for each trace */
     stats_t *mm_stats = NULL;  /* mm (i.e. student) stats for each trace */
-    speed_t speed_params;      /* input parameters to the xx_speed routines */ 
+    stats_t *base_stats = NULL;/* mm stats on base pages, for -c */
 
     int run_libc = 0;    /* If set, run libc malloc (set by -l) */
     int autograder = 0;  /* If set, emit summary info for autograder (-g) */
+    int mt_threads = 0;  /* If set, replay on this many threads (-T) */
+    int mt_partition = 0;/* If set, split each trace among the threads (-P) */
+    mtstats_t *mt_stats = NULL; /* threaded replay stats for each trace */
+    int regions = 0;     /* If set, compare region release with mm_free (-R) */
+    regstats_t *reg_stats = NULL; /* region replay stats for each trace */
+    int latency = 0;     /* If set, time every request (-L) */
+    char *histfile = NULL; /* If set, dump latency histograms here (-H) */
+    hist_t *lat_hists = NULL;  /* latencies of each op type of each trace */
+    int counters = 0;    /* If set, read the hardware counters (-C) */
+    int jobs = 1;        /* Evaluate this many traces at once (-j) */
+    char *outfile = NULL;  /* If set, write the results here (-o) */
+    char *basefile = NULL; /* If set, compare with this baseline (-b) */
+    double regress_pct = REGRESS_PCT; /* ...and flag drops this big (-r) */
+    int regressions = 0; /* traces that fell behind the baseline */
+    char *seriesfile = SERIES_FILE; /* heap time series goes here (-S) */
+    int pages = MEM_PAGES_BASE;  /* kind of page to back the heap (-p) */
+    int cmp_pages = 0;   /* If set, also run on base pages and compare (-c) */
 
     /* temporaries used to compute the performance index */
     double secs, ops, util, avg_mm_util, avg_mm_throughput, p1, p2, perfindex;
@@ -157,8 +300,29 @@ int main(int argc, char **argv)
     /* 
      * Read and interpret the command line arguments 
      */
-    while ((c = getopt(argc, argv, "f:t:hvVgal")) != EOF) {
+    while ((c = getopt(argc, argv, "f:t:m:T:H:j:o:b:r:s:S:p:hvVgaclLPCR")) != EOF) {
         switch (c) {
+	case 'b': /* Compare with a baseline written by -o */
+	    basefile = optarg;
+	    break;
+	case 'o': /* Write the results as JSON, or CSV if file ends in .csv */
+	    outfile = optarg;
+	    break;
+	case 'r': /* Percent drop in Kops or util that -b flags */
+	    if ((regress_pct = atof(optarg)) < 0) {
+		usage();
+		exit(1);
+	    }
+	    break;
+	case 's': /* Sample the heap layout every this many ops */
+	    if ((series_ops = atoi(optarg)) < 1) {
+		usage();
+		exit(1);
+	    }
+	    break;
+	case 'S': /* ... and write the samples to this file */
+	    seriesfile = optarg;
+	    break;
 	case 'g': /* Generate summary info for the autograder */
 	    autograder = 1;
 	    break;
@@ -177,9 +341,54 @@ int main(int argc, char **argv)
 	    if (tracedir[strlen(tracedir)-1] != '/') 
 		strcat(tracedir, "/"); /* path always ends with "/" */
 	    break;
+	case 'C': /* Count cache misses etc. with the hardware counters */
+	    counters = 1;
+	    break;
+	case 'j': /* Evaluate traces in this many workers; 0 = one per core */
+	    if ((jobs = atoi(optarg)) < 0) {
+		usage();
+		exit(1);
+	    }
+	    if (jobs == 0)
+		jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	    break;
         case 'l': /* Run libc malloc */
             run_libc = 1;
             break;
+	case 'L': /* Time every request and report latency percentiles */
+	    latency = 1;
+	    break;
+	case 'H': /* Also dump the latency histograms to a file */
+	    latency = 1;
+	    histfile = optarg;
+	    break;
+	case 'm': /* Give blocks of at least this many bytes their own mmap */
+	    mem_set_map_threshold(strtoul(optarg, NULL, 0));
+	    break;
+	case 'p': /* Back the heap with base, thp, or hugetlb pages */
+	    for (pages = 0; pages <= MEM_PAGES_HUGETLB && 
+		     strcmp(optarg, page_kinds[pages]); pages++)
+		;
+	    if (pages > MEM_PAGES_HUGETLB) {
+		usage();
+		exit(1);
+	    }
+	    break;
+	case 'c': /* Also run on base pages, and compare with the -p pages */
+	    cmp_pages = 1;
+	    break;
+	case 'R': /* Also compare region release with per-object mm_free */
+	    regions = 1;
+	    break;
+	case 'P': /* Partition each trace among the threads instead of copying */
+	    mt_partition = 1;
+	    break;
+	case 'T': /* Also replay each trace on this many threads */
+	    if ((mt_threads = atoi(optarg)) < 1) {
+		usage();
+		exit(1);
+	    }
+	    break;
         case 'v': /* Print per-trace performance breakdown */
             verbose = 1;
             break;
@@ -205,8 +414,17 @@ int main(int argc, char **argv)
 	printf("Using default tracefiles in %s\n", tracedir);
     }
 
+    /* Workers that share a core slow each other down */
+    if (jobs > sysconf(_SC_NPROCESSORS_ONLN))
+	printf("Warning: %d workers on %ld cores will inflate the times\n",
+	       jobs, sysconf(_SC_NPROCESSORS_ONLN));
+
     /* Initialize the timing package */
     init_fsecs();
+    if (counters && perf_init(verbose > 1) == 0) {
+	printf("Hardware counters are not available; ignoring -C.\n");
+	counters = 0;
+    }
 
     /*
      * Optionally run and evaluate the libc malloc package 
@@ -221,20 +439,7 @@ int main(int argc, char **argv)
 	    unix_error("libc_stats calloc in main failed");
 	
 	/* Evaluate the libc malloc package using the K-best scheme */
-	for (i=0; i < num_tracefiles; i++) {
-	    trace = read_trace(tracedir, tracefiles[i]);
-	    libc_stats[i].ops = trace->num_ops;
-	    if (verbose > 1)
-		printf("Checking libc malloc for correctness, ");
-	    libc_stats[i].valid = eval_libc_valid(trace, i);
-	    if (libc_stats[i].valid) {
-		speed_params.trace = trace;
-		if (verbose > 1)
-		    printf("and performance.\n");
-		libc_stats[i].secs = fsecs(eval_libc_speed, &speed_params);
-	    }
-	    free_trace(trace);
-	}
+	eval_traces(num_tracefiles, tracefiles, jobs, 1, libc_stats, NULL, 0);
 
 	/* Display the libc results in a compact table */
 	if (verbose) {
@@ -254,33 +459,126 @@ int main(int argc, char **argv)
     if (mm_stats == NULL)
 	unix_error("mm_stats calloc in main failed");
     
+    /* Allocate one latency histogram per op type per trace */
+    if (latency) {
+	lat_hists = (hist_t *)calloc(3*num_tracefiles, sizeof(hist_t));
+	if (lat_hists == NULL)
+	    unix_error("lat_hists calloc in main failed");
+    }
+
+    /* 
+     * Optionally run on base pages first, to compare the -p pages with
+     */
+    if (cmp_pages) {
+	if (pages == MEM_PAGES_BASE)
+	    pages = MEM_PAGES_THP;
+	if (verbose > 1)
+	    printf("Testing mm malloc on base pages\n");
+	base_stats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
+	if (base_stats == NULL)
+	    unix_error("base_stats calloc in main failed");
+	mem_set_pages(MEM_PAGES_BASE);
+	mem_init();
+	eval_traces(num_tracefiles, tracefiles, jobs, 0, base_stats, NULL,
+		    counters);
+	mem_deinit();
+    }
+
     /* Initialize the simulated memory system in memlib.c */
+    mem_set_pages(pages);
     mem_init(); 
+    if (mem_pages() != pages)
+	printf("Could not back the heap with %s pages; using %s pages.\n",
+	       page_kinds[pages], page_kinds[mem_pages()]);
+    else if (verbose > 1)
+	printf("Heap backed by %s pages\n", page_kinds[pages]);
+    if (series_ops)
+	open_series(seriesfile);
 
     /* Evaluate student's mm malloc package using the K-best scheme */
-    for (i=0; i < num_tracefiles; i++) {
-	trace = read_trace(tracedir, tracefiles[i]);
-	mm_stats[i].ops = trace->num_ops;
-	if (verbose > 1)
-	    printf("Checking mm_malloc for correctness, ");
-	mm_stats[i].valid = eval_mm_valid(trace, i, &ranges);
-	if (mm_stats[i].valid) {
-	    if (verbose > 1)
-		printf("efficiency, ");
-	    mm_stats[i].util = eval_mm_util(trace, i, &ranges);
-	    speed_params.trace = trace;
-	    speed_params.ranges = ranges;
-	    if (verbose > 1)
-		printf("and performance.\n");
-	    mm_stats[i].secs = fsecs(eval_mm_speed, &speed_params);
-	}
-	free_trace(trace);
-    }
+    eval_traces(num_tracefiles, tracefiles, jobs, 0, mm_stats, lat_hists,
+		counters);
 
     /* Display the mm results in a compact table */
     if (verbose) {
 	printf("\nResults for mm malloc:\n");
 	printresults(num_tracefiles, mm_stats);
+	printfrag(num_tracefiles, mm_stats);
+	printreallocs(num_tracefiles, mm_stats);
+	printf("\n");
+    }
+
+    if (series_ops) {
+	close(series_fd);
+	if (verbose)
+	    printf("Wrote heap samples every %d ops to %s\n\n", 
+		   series_ops, seriesfile);
+    }
+
+    /* Save the results, and check them against the baseline */
+    if (outfile != NULL)
+	write_results(outfile, num_tracefiles, tracefiles, mm_stats, lat_hists);
+    if (basefile != NULL) {
+	regressions = compare_baseline(basefile, num_tracefiles, tracefiles,
+				       mm_stats, regress_pct);
+	printf("\n");
+    }
+
+    /* Display the change from base pages to the -p pages */
+    if (cmp_pages) {
+	printpages(num_tracefiles, base_stats, mm_stats, mem_pages(), counters);
+	printf("\n");
+    }
+
+    /* Display the hardware counts per op of each trace */
+    if (counters) {
+	printperf(num_tracefiles, mm_stats);
+	printf("\n");
+    }
+
+    /* Display the latency percentiles of each trace */
+    if (latency) {
+	printlatency(num_tracefiles, lat_hists, tracefiles, histfile);
+	printf("\n");
+    }
+
+    /*
+     * Optionally replay the traces on several threads through mm_mt
+     */
+    if (mt_threads) {
+	if (verbose > 1)
+	    printf("Testing mm_mt malloc on %d threads\n", mt_threads);
+	mt_stats = (mtstats_t *)calloc(num_tracefiles, sizeof(mtstats_t));
+	if (mt_stats == NULL)
+	    unix_error("mt_stats calloc in main failed");
+	for (i=0; i < num_tracefiles; i++) {
+	    if (!mm_stats[i].valid)
+		continue;
+	    trace = read_trace(tracedir, tracefiles[i]);
+	    eval_mm_mt(trace, mt_threads, mt_partition, &mt_stats[i]);
+	    free_trace(trace);
+	}
+	printmt(num_tracefiles, mt_stats, mt_threads, mt_partition);
+	printf("\n");
+    }
+
+    /*
+     * Optionally replay the traces as requests whose blocks die together
+     */
+    if (regions) {
+	if (verbose > 1)
+	    printf("Testing region release against mm_free\n");
+	reg_stats = (regstats_t *)calloc(num_tracefiles, sizeof(regstats_t));
+	if (reg_stats == NULL)
+	    unix_error("reg_stats calloc in main failed");
+	for (i=0; i < num_tracefiles; i++) {
+	    if (!mm_stats[i].valid)
+		continue;
+	    trace = read_trace(tracedir, tracefiles[i]);
+	    eval_mm_region(trace, &reg_stats[i]);
+	    free_trace(trace);
+	}
+	printregion(num_tracefiles, reg_stats);
 	printf("\n");
     }
 
@@ -332,21 +630,243 @@ int main(int argc, char **argv)
 	printf("perfidx:%.0f\n", perfindex);
     }
 
+    if (regressions > 0) {
+	printf("%d trace%s failed or regressed by more than %g%% against %s\n",
+	       regressions, regressions == 1 ? "" : "s", regress_pct, basefile);
+	exit(2);
+    }
+
+    /* Nor does a run with errors, or with nothing to compare, pass -b */
+    if (basefile != NULL && (errors > 0 || regressions < 0))
+	exit(2);
     exit(0);
 }
 
 
 /*****************************************************************
- * The following routines manipulate the range list, which keeps 
+ * The following routines evaluate every trace, one after another or,
+ * with -j, in forked worker processes.  Each worker evaluates one
+ * trace on its own copy of the memlib heap and sends its stats_t, its
+ * error count, and its latency histograms back over a pipe.
+ ****************************************************************/
+
+/*
+ * eval_traces - Evaluate each of the n traces with libc malloc (libc
+ *     set) or with mm, filling in stats[i] and, if hists is not NULL,
+ *     the latency histograms hists[3*i..3*i+2] of trace i.  With jobs
+ *     > 1, up to jobs traces are evaluated at once in worker processes.
+ */
+static void eval_traces(int n, char **tracefiles, int jobs, int libc,
+			stats_t *stats, hist_t *hists, int counters)
+{
+    struct pollfd *pfds;       /* result pipe of each running worker */
+    int *slot_trace;           /* trace each running worker evaluates */
+    pid_t *slot_pid;           /* ...and its process id */
+    int i, w, next, active, nerrs, fd[2];
+    size_t hlen = (hists != NULL) ? 3*sizeof(hist_t) : 0;
+    stats_t result;
+    pid_t pid;
+
+    if (jobs <= 1 || n <= 1) {
+	for (i = 0; i < n; i++) {
+	    if (libc)
+		eval_libc_trace(i, tracefiles[i], &stats[i]);
+	    else
+		eval_mm_trace(i, tracefiles[i], &stats[i], 
+			      hists ? &hists[3*i] : NULL, counters);
+	}
+	return;
+    }
+
+    pfds = (struct pollfd *)calloc(jobs, sizeof(struct pollfd));
+    slot_trace = (int *)calloc(jobs, sizeof(int));
+    slot_pid = (pid_t *)calloc(jobs, sizeof(pid_t));
+    if (pfds == NULL || slot_trace == NULL || slot_pid == NULL)
+	unix_error("calloc failed in eval_traces");
+
+    for (next = active = 0; next < n || active > 0; ) {
+	/* Start workers on the next traces while there are free slots */
+	while (next < n && active < jobs) {
+	    if (pipe(fd) < 0)
+		unix_error("pipe failed in eval_traces");
+	    fflush(stdout);
+	    if ((pid = fork()) < 0)
+		unix_error("fork failed in eval_traces");
+	    if (pid == 0) {
+		close(fd[0]);
+		errors = 0;
+		if (libc)
+		    eval_libc_trace(next, tracefiles[next], &stats[next]);
+		else {
+		    if (counters)
+			perf_close();   /* the parent's count only itself */
+		    eval_mm_trace(next, tracefiles[next], &stats[next],
+				  hists ? &hists[3*next] : NULL, counters);
+		}
+		write_all(fd[1], &stats[next], sizeof(stats_t));
+		write_all(fd[1], &errors, sizeof(int));
+		if (hists != NULL)
+		    write_all(fd[1], &hists[3*next], hlen);
+		fflush(stdout);
+		_exit(0);
+	    }
+	    close(fd[1]);
+	    pfds[active].fd = fd[0];
+	    pfds[active].events = POLLIN;
+	    slot_trace[active] = next++;
+	    slot_pid[active++] = pid;
+	}
+
+	/* Collect the results of a worker that has finished */
+	if (poll(pfds, active, -1) < 0) {
+	    if (errno == EINTR)
+		continue;
+	    unix_error("poll failed in eval_traces");
+	}
+	for (w = 0; w < active && pfds[w].revents == 0; w++)
+	    ;
+	if (w == active)
+	    continue;
+	i = slot_trace[w];
+	if (read_all(pfds[w].fd, &result, sizeof(stats_t)) &&
+	    read_all(pfds[w].fd, &nerrs, sizeof(int)) &&
+	    (hists == NULL || read_all(pfds[w].fd, &hists[3*i], hlen))) {
+	    stats[i] = result;
+	    errors += nerrs;
+	}
+	else {
+	    printf("ERROR [trace %d]: worker died before reporting\n", i);
+	    errors++;
+	    stats[i].valid = 0;
+	}
+	close(pfds[w].fd);
+	waitpid(slot_pid[w], NULL, 0);
+
+	/* Give its slot to the last running worker */
+	active--;
+	pfds[w] = pfds[active];
+	slot_trace[w] = slot_trace[active];
+	slot_pid[w] = slot_pid[active];
+    }
+
+    free(pfds);
+    free(slot_trace);
+    free(slot_pid);
+}
+
+/*
+ * eval_libc_trace - Check and time libc malloc on trace i
+ */
+static void eval_libc_trace(int i, char *tracefile, stats_t *stats)
+{
+    trace_t *trace;
+    speed_t speed_params;
+
+    trace = read_trace(tracedir, tracefile);
+    stats->ops = trace->num_ops;
+    if (verbose > 1)
+	printf("Checking libc malloc for correctness, ");
+    stats->valid = eval_libc_valid(trace, i);
+    if (stats->valid) {
+	speed_params.trace = trace;
+	if (verbose > 1)
+	    printf("and performance.\n");
+	stats->secs = fsecs(eval_libc_speed, &speed_params);
+	stats->ci = fsecs_ci();
+    }
+    free_trace(trace);
+}
+
+/*
+ * eval_mm_trace - Check mm on trace i, then measure its utilization and
+ *     speed, and its counter events and latencies if asked
+ */
+static void eval_mm_trace(int i, char *tracefile, stats_t *stats,
+			  hist_t *hists, int counters)
+{
+    trace_t *trace;
+    range_t *ranges = NULL;
+    speed_t speed_params;
+
+    trace = read_trace(tracedir, tracefile);
+    stats->ops = trace->num_ops;
+    if (verbose > 1)
+	printf("Checking mm_malloc for correctness, ");
+    stats->valid = eval_mm_valid(trace, i, &ranges);
+    if (stats->valid) {
+	if (verbose > 1)
+	    printf("efficiency, ");
+	stats->util = eval_mm_util(trace, i, &ranges, stats);
+	mm_get_realloc_stats(&stats->realloc);
+	speed_params.trace = trace;
+	speed_params.ranges = ranges;
+	if (verbose > 1)
+	    printf("and performance.\n");
+	stats->secs = fsecs(eval_mm_speed, &speed_params);
+	stats->ci = fsecs_ci();
+	if (counters)
+	    perf_measure(eval_mm_speed, &speed_params, PERF_REPS,
+			 &stats->perf);
+	if (hists != NULL)
+	    eval_mm_latency(trace, hists);
+    }
+    clear_ranges(&ranges);
+    free_trace(trace);
+}
+
+/*
+ * read_all - Read exactly len bytes from fd; returns 0 if it ends first
+ */
+static int read_all(int fd, void *buf, size_t len)
+{
+    ssize_t r;
+
+    while (len > 0) {
+	if ((r = read(fd, buf, len)) < 0 && errno == EINTR)
+	    continue;
+	if (r <= 0)
+	    return 0;
+	buf = (char *)buf + r;
+	len -= r;
+    }
+    return 1;
+}
+
+/*
+ * write_all - Write all len bytes of buf to fd
+ */
+static void write_all(int fd, void *buf, size_t len)
+{
+    ssize_t r;
+
+    while (len > 0) {
+	if ((r = write(fd, buf, len)) < 0 && errno == EINTR)
+	    continue;
+	if (r <= 0)
+	    unix_error("write failed in write_all");
+	buf = (char *)buf + r;
+	len -= r;
+    }
+}
+
+
+/*****************************************************************
+ * The following routines manipulate the range tree, which keeps 
  * track of the extent of every allocated block payload. We use the 
- * range list to detect any overlapping allocated blocks.
+ * range tree to detect any overlapping allocated blocks.
+ *
+ * The tree is an AVL tree ordered by the low address of each range.
+ * Since the ranges in the tree never overlap, they are ordered by
+ * their high addresses too, so a new block overlaps some range iff it
+ * overlaps the range with the largest lo at or below its own hi.
+ * That makes every check, insertion, and removal O(log n).
  ****************************************************************/
 
 /*
  * add_range - As directed by request opnum in trace tracenum,
  *     we've just called the student's mm_malloc to allocate a block of 
  *     size bytes at addr lo. After checking the block for correctness,
- *     we create a range struct for this block and add it to the range list. 
+ *     we create a range struct for this block and add it to the range tree. 
  */
 static int add_range(range_t **ranges, char *lo, int size, 
 		     int tracenum, int opnum)
@@ -365,9 +885,11 @@ static int add_range(range_t **ranges, char *lo, int size,
         return 0;
     }
 
-    /* The payload must lie within the extent of the heap */
-    if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) || 
-	(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
+    /* The payload must lie within the extent of the heap, or else
+       within a single region that the allocator got from mem_map */
+    if (((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) || 
+	 (hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) &&
+	!mem_is_mapped(lo, hi)) {
 	sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p)",
 		lo, hi, mem_heap_lo(), mem_heap_hi());
 	malloc_error(tracenum, opnum, msg);
@@ -375,26 +897,24 @@ static int add_range(range_t **ranges, char *lo, int size,
     }
 
     /* The payload must not overlap any other payloads */
-    for (p = *ranges;  p != NULL;  p = p->next) {
-        if ((lo >= p->lo && lo <= p-> hi) ||
-            (hi >= p->lo && hi <= p->hi)) {
-	    sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n",
-		    lo, hi, p->lo, p->hi);
-	    malloc_error(tracenum, opnum, msg);
-	    return 0;
-        }
+    if ((p = find_range(*ranges, hi)) != NULL && p->hi >= lo) {
+	sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n",
+		lo, hi, p->lo, p->hi);
+	malloc_error(tracenum, opnum, msg);
+	return 0;
     }
 
     /* 
      * Everything looks OK, so remember the extent of this block 
-     * by creating a range struct and adding it the range list.
+     * by creating a range struct and adding it the range tree.
      */
     if ((p = (range_t *)malloc(sizeof(range_t))) == NULL)
 	unix_error("malloc error in add_range");
-    p->next = *ranges;
     p->lo = lo;
     p->hi = hi;
-    *ranges = p;
+    p->left = p->right = NULL;
+    p->height = 1;
+    *ranges = insert_range(*ranges, p);
     return 1;
 }
 
@@ -403,34 +923,130 @@ static int add_range(range_t **ranges, char *lo, int size,
  */
 static void remove_range(range_t **ranges, char *lo)
 {
-    range_t *p;
-    range_t **prevpp = ranges;
-    int size;
-
-    for (p = *ranges;  p != NULL; p = p->next) {
-        if (p->lo == lo) {
-	    *prevpp = p->next;
-            size = p->hi - p->lo + 1;
-            free(p);
-            break;
-        }
-        prevpp = &(p->next);
-    }
+    *ranges = delete_range(*ranges, lo);
 }
 
 /*
  * clear_ranges - free all of the range records for a trace 
  */
 static void clear_ranges(range_t **ranges)
+{
+    range_t *p = *ranges;
+
+    if (p == NULL)
+	return;
+    clear_ranges(&p->left);
+    clear_ranges(&p->right);
+    free(p);
+    *ranges = NULL;
+}
+
+/*
+ * find_range - Return the range with the largest lo that is <= addr,
+ *     or NULL if every range starts above addr
+ */
+static range_t *find_range(range_t *t, char *addr)
+{
+    range_t *best = NULL;
+
+    while (t != NULL) {
+	if (t->lo <= addr) {
+	    best = t;
+	    t = t->right;
+	}
+	else
+	    t = t->left;
+    }
+    return best;
+}
+
+/*
+ * rotate - Rotate subtree t so that its left (dir == 0) or right
+ *     (dir == 1) child becomes the root; return the new root
+ */
+static range_t *rotate(range_t *t, int dir)
+{
+    range_t *c;
+
+    if (dir == 0) {
+	c = t->left;
+	t->left = c->right;
+	c->right = t;
+    }
+    else {
+	c = t->right;
+	t->right = c->left;
+	c->left = t;
+    }
+    t->height = 1 + MAX(HEIGHT(t->left), HEIGHT(t->right));
+    c->height = 1 + MAX(HEIGHT(c->left), HEIGHT(c->right));
+    return c;
+}
+
+/*
+ * rebalance - Restore the AVL property at t after one of its subtrees
+ *     changed height by one; return the new root of the subtree
+ */
+static range_t *rebalance(range_t *t)
+{
+    int bal = HEIGHT(t->left) - HEIGHT(t->right);
+
+    if (bal > 1) {
+	if (HEIGHT(t->left->left) < HEIGHT(t->left->right))
+	    t->left = rotate(t->left, 1);
+	return rotate(t, 0);
+    }
+    if (bal < -1) {
+	if (HEIGHT(t->right->right) < HEIGHT(t->right->left))
+	    t->right = rotate(t->right, 0);
+	return rotate(t, 1);
+    }
+    t->height = 1 + MAX(HEIGHT(t->left), HEIGHT(t->right));
+    return t;
+}
+
+/*
+ * insert_range - Add range p to subtree t; return the new root
+ */
+static range_t *insert_range(range_t *t, range_t *p)
+{
+    if (t == NULL)
+	return p;
+    if (p->lo < t->lo)
+	t->left = insert_range(t->left, p);
+    else
+	t->right = insert_range(t->right, p);
+    return rebalance(t);
+}
+
+/*
+ * delete_range - Remove and free the range starting at lo from subtree
+ *     t, if there is one; return the new root
+ */
+static range_t *delete_range(range_t *t, char *lo)
 {
     range_t *p;
-    range_t *pnext;
 
-    for (p = *ranges;  p != NULL;  p = pnext) {
-        pnext = p->next;
-        free(p);
+    if (t == NULL)
+	return NULL;
+    if (lo < t->lo)
+	t->left = delete_range(t->left, lo);
+    else if (lo > t->lo)
+	t->right = delete_range(t->right, lo);
+    else {
+	if (t->left == NULL || t->right == NULL) {
+	    p = (t->left != NULL) ? t->left : t->right;
+	    free(t);
+	    return p;
+	}
+	/* Replace t by its successor, the leftmost range on the right */
+	for (p = t->right; p->left != NULL; p = p->left)
+	    ;
+	t->lo = p->lo;
+	t->hi = p->hi;
+	t->right = delete_range(t->right, p->lo);
     }
-    *ranges = NULL;
+    return rebalance(t);
 }
 
 
@@ -447,9 +1063,10 @@ static trace_t *read_trace(char *tracedir, char *filename)
     trace_t *trace;
     char type[MAXLINE];
     char path[MAXLINE];
-    unsigned index, size;
+    unsigned index, size, align;
     unsigned max_index = 0;
     unsigned op_index;
+    uint32_t magic;
 
     if (verbose > 1)
 	printf("Reading tracefile: %s\n", filename);
@@ -462,18 +1079,28 @@ static trace_t *read_trace(char *tracedir, char *filename)
     strcpy(path, tracedir);
     strcat(path, filename);
     if ((tracefile = fopen(path, "r")) == NULL) {
-	sprintf(msg, "Could not open %s in read_trace", path);
+	snprintf(msg, MAXLINE, "Could not open %s in read_trace", path);
 	unix_error(msg);
     }
-    fscanf(tracefile, "%d", &(trace->sugg_heapsize)); /* not used */
-    fscanf(tracefile, "%d", &(trace->num_ids));     
-    fscanf(tracefile, "%d", &(trace->num_ops));     
-    fscanf(tracefile, "%d", &(trace->weight));        /* not used */
+    trace->map = NULL;
+    trace->map_len = 0;
+    if (fread(&magic, sizeof(magic), 1, tracefile) == 1 && 
+	magic == TRACE_MAGIC) {
+	/* A binary trace: its requests are used in place */
+	map_trace(trace, tracefile, path);
+    }
+    else {
+	rewind(tracefile);
+	fscanf(tracefile, "%d", &(trace->sugg_heapsize)); /* not used */
+	fscanf(tracefile, "%d", &(trace->num_ids));     
+	fscanf(tracefile, "%d", &(trace->num_ops));     
+	fscanf(tracefile, "%d", &(trace->weight));        /* not used */
     
-    /* We'll store each request line in the trace in this array */
-    if ((trace->ops = 
-	 (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
-	unix_error("malloc 2 failed in read_trace");
+	/* We'll store each request line in the trace in this array */
+	if ((trace->ops = 
+	     (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
+	    unix_error("malloc 2 failed in read_trace");
+    }
 
     /* We'll keep an array of pointers to the allocated blocks here... */
     if ((trace->blocks = 
@@ -484,6 +1111,11 @@ static trace_t *read_trace(char *tracedir, char *filename)
     if ((trace->block_sizes = 
 	 (size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
 	unix_error("malloc 4 failed in read_trace");
+
+    if (trace->map != NULL) {
+	fclose(tracefile);
+	return trace;
+    }
     
     /* read every request line in the trace file */
     index = 0;
@@ -504,6 +1136,14 @@ static trace_t *read_trace(char *tracedir, char *filename)
 	    trace->ops[op_index].size = size;
 	    max_index = (index > max_index) ? index : max_index;
 	    break;
+	case 'm':
+	    fscanf(tracefile, "%u %u %u", &index, &align, &size);
+	    trace->ops[op_index].type = MEMALIGN;
+	    trace->ops[op_index].index = index;
+	    trace->ops[op_index].size = size;
+	    trace->ops[op_index].align = align;
+	    max_index = (index > max_index) ? index : max_index;
+	    break;
 	case 'f':
 	    fscanf(tracefile, "%ud", &index);
 	    trace->ops[op_index].type = FREE;
@@ -524,13 +1164,66 @@ static trace_t *read_trace(char *tracedir, char *filename)
     return trace;
 }
 
+/*
+ * map_trace - Map the binary trace file open as tracefile and point
+ *     trace's header fields and request array into the mapping.  The
+ *     ids are checked once here so that replay can index with them.
+ */
+static void map_trace(trace_t *trace, FILE *tracefile, char *path)
+{
+    struct stat st;
+    tracehdr_t *hdr;
+    traceop_t *op;
+    int i;
+
+    if (fstat(fileno(tracefile), &st) < 0)
+	unix_error("fstat failed in map_trace");
+    if (st.st_size < sizeof(tracehdr_t)) {
+	printf("Truncated binary tracefile %s\n", path);
+	exit(1);
+    }
+    hdr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, 
+	       fileno(tracefile), 0);
+    if (hdr == MAP_FAILED)
+	unix_error("mmap failed in map_trace");
+    madvise(hdr, st.st_size, MADV_SEQUENTIAL);
+    trace->map = hdr;
+    trace->map_len = st.st_size;
+
+    if (hdr->version != TRACE_VERSION || hdr->num_ops > INT_MAX ||
+	st.st_size != sizeof(*hdr) + (size_t)hdr->num_ops * sizeof(traceop_t)) {
+	printf("Bad binary tracefile %s (version %u, %u requests, %ld bytes)\n",
+	       path, hdr->version, hdr->num_ops, (long)st.st_size);
+	exit(1);
+    }
+    trace->sugg_heapsize = hdr->sugg_heapsize;
+    trace->num_ids = hdr->num_ids;
+    trace->num_ops = hdr->num_ops;
+    trace->weight = hdr->weight;
+    trace->ops = (traceop_t *)(hdr + 1);
+
+    for (i = 0, op = trace->ops; i < trace->num_ops; i++, op++) {
+	if (op->index < 0 || op->index >= trace->num_ids ||
+	    (op->type != ALLOC && op->type != FREE && op->type != REALLOC &&
+	     op->type != MEMALIGN) ||
+	    (op->type == MEMALIGN && 
+	     (op->align <= 0 || (op->align & (op->align - 1))))) {
+	    printf("Bogus request %d in binary tracefile %s\n", i, path);
+	    exit(1);
+	}
+    }
+}
+
 /*
  * free_trace - Free the trace record and the three arrays it points
  *              to, all of which were allocated in read_trace().
  */
 void free_trace(trace_t *trace)
 {
-    free(trace->ops);         /* free the three arrays... */
+    if (trace->map != NULL)   /* unmap or free the three arrays... */
+	munmap(trace->map, trace->map_len);
+    else
+	free(trace->ops);
     free(trace->blocks);      
     free(trace->block_sizes);
     free(trace);              /* and the trace record itself... */
@@ -554,7 +1247,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
     char *oldp;
     char *p;
     
-    /* Reset the heap and free any records in the range list */
+    /* Reset the heap and free any records in the range tree */
     mem_reset_brk();
     clear_ranges(ranges);
 
@@ -581,7 +1274,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    
 	    /* 
 	     * Test the range of the new block for correctness and add it 
-	     * to the range list if OK. The block must be  be aligned properly,
+	     * to the range tree if OK. The block must be  be aligned properly,
 	     * and must not overlap any currently allocated block. 
 	     */ 
 	    if (add_range(ranges, p, size, tracenum, i) == 0)
@@ -599,6 +1292,28 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    trace->block_sizes[index] = size;
 	    break;
 
+        case MEMALIGN: /* mm_memalign */
+
+	    /* Call the student's memalign */
+	    if ((p = mm_memalign(trace->ops[i].align, size)) == NULL) {
+		malloc_error(tracenum, i, "mm_memalign failed.");
+		return 0;
+	    }
+
+	    /* The block must have the alignment asked for as well */
+	    if ((size_t)p & (trace->ops[i].align - 1)) {
+		sprintf(msg, "Payload address (%p) not aligned to %d bytes",
+			p, trace->ops[i].align);
+		malloc_error(tracenum, i, msg);
+		return 0;
+	    }
+	    if (add_range(ranges, p, size, tracenum, i) == 0)
+		return 0;
+	    memset(p, index & 0xFF, size);
+	    trace->blocks[index] = p;
+	    trace->block_sizes[index] = size;
+	    break;
+
         case REALLOC: /* mm_realloc */
 	    
 	    /* Call the student's realloc */
@@ -608,10 +1323,10 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 		return 0;
 	    }
 	    
-	    /* Remove the old region from the range list */
+	    /* Remove the old region from the range tree */
 	    remove_range(ranges, oldp);
 	    
-	    /* Check new block for correctness and add it to range list */
+	    /* Check new block for correctness and add it to range tree */
 	    if (add_range(ranges, newp, size, tracenum, i) == 0)
 		return 0;
 	    
@@ -623,7 +1338,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    oldsize = trace->block_sizes[index];
 	    if (size < oldsize) oldsize = size;
 	    for (j = 0; j < oldsize; j++) {
-	      if (newp[j] != (index & 0xFF)) {
+	      if ((unsigned char)newp[j] != (index & 0xFF)) {
 		malloc_error(tracenum, i, "mm_realloc did not preserve the "
 			     "data from old block");
 		return 0;
@@ -659,36 +1374,62 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
  *   The idea is to remember the high water mark "hwm" of the heap for 
  *   an optimal allocator, i.e., no gaps and no internal fragmentation.
  *   Utilization is the ratio hwm/heapsize, where heapsize is the 
- *   size of the heap in bytes after running the student's malloc 
- *   package on the trace. Note that our implementation of mem_sbrk() 
- *   doesn't allow the students to decrement the brk pointer, so brk
- *   is always the high water mark of the heap. 
+ *   most bytes that the heap and the regions from mem_map held 
+ *   together at any point while running the student's malloc package
+ *   on the trace. Both the brk pointer and the mapped regions can go
+ *   down as well as up, so their final size is not the high water mark.
  *   
+ *   Also records in stats the internal fragmentation at the high water
+ *   mark (usable block bytes beyond the requested payloads, which
+ *   includes slab size class rounding) and the share of the heap that
+ *   the slab allocator holds, both as fractions of heapsize, and the
+ *   peak and final resident set of the heap. Payloads are touched so
+ *   that the resident set is what a real program would see; the peak
+ *   is sampled whenever the heap changes size and every RSS_SAMPLE ops.
  */
-static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
+static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges,
+			   stats_t *stats)
 {   
     int i;
     int index;
     int size, newsize, oldsize;
     int max_total_size = 0;
     int total_size = 0;
+    size_t usable = 0;     /* sum of mm_usable_size over live blocks */
+    size_t max_usable = 0; /* ... when total_size peaked */
+    size_t heapsize = 0;   /* most bytes held in heap + mapped regions */
+    size_t cursize = 0;    /* ... at the previous op */
+    size_t rss, rss_peak = 0;
     char *p;
     char *newp, *oldp;
+    FILE *series = NULL;   /* heap samples of this trace (-s) */
+    char *sbuf = NULL;
+    size_t slen = 0;
 
-    /* initialize the heap and the mm malloc package */
+    /* initialize the heap and the mm malloc package, and start with
+       none of the heap resident */
     mem_reset_brk();
+    mem_release(mem_heap_lo(), MAX_HEAP);
     if (mm_init() < 0)
 	app_error("mm_init failed in eval_mm_util");
+    if (series_ops && (series = open_memstream(&sbuf, &slen)) == NULL)
+	unix_error("open_memstream failed in eval_mm_util");
 
     for (i = 0;  i < trace->num_ops;  i++) {
         switch (trace->ops[i].type) {
 
         case ALLOC: /* mm_alloc */
+        case MEMALIGN: /* mm_memalign */
 	    index = trace->ops[i].index;
 	    size = trace->ops[i].size;
 
-	    if ((p = mm_malloc(size)) == NULL) 
+	    if (trace->ops[i].type == MEMALIGN)
+		p = mm_memalign(trace->ops[i].align, size);
+	    else
+		p = mm_malloc(size);
+	    if (p == NULL) 
 		app_error("mm_malloc failed in eval_mm_util");
+	    memset(p, 0, size);
 	    
 	    /* Remember region and size */
 	    trace->blocks[index] = p;
@@ -697,10 +1438,13 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    /* Keep track of current total size
 	     * of all allocated blocks */
 	    total_size += size;
+	    usable += mm_usable_size(p);
 	    
 	    /* Update statistics */
-	    max_total_size = (total_size > max_total_size) ?
-		total_size : max_total_size;
+	    if (total_size > max_total_size) {
+		max_total_size = total_size;
+		max_usable = usable;
+	    }
 	    break;
 
 	case REALLOC: /* mm_realloc */
@@ -709,8 +1453,10 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    oldsize = trace->block_sizes[index];
 
 	    oldp = trace->blocks[index];
+	    usable -= mm_usable_size(oldp);
 	    if ((newp = mm_realloc(oldp,newsize)) == NULL)
 		app_error("mm_realloc failed in eval_mm_util");
+	    memset(newp, 0, newsize);
 
 	    /* Remember region and size */
 	    trace->blocks[index] = newp;
@@ -719,16 +1465,20 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    /* Keep track of current total size
 	     * of all allocated blocks */
 	    total_size += (newsize - oldsize);
+	    usable += mm_usable_size(newp);
 	    
 	    /* Update statistics */
-	    max_total_size = (total_size > max_total_size) ?
-		total_size : max_total_size;
+	    if (total_size > max_total_size) {
+		max_total_size = total_size;
+		max_usable = usable;
+	    }
 	    break;
 
         case FREE: /* mm_free */
 	    index = trace->ops[i].index;
 	    size = trace->block_sizes[index];
 	    p = trace->blocks[index];
+	    usable -= mm_usable_size(p);
 	    
 	    mm_free(p);
 	    
@@ -742,12 +1492,85 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    app_error("Nonexistent request type in eval_mm_util");
 
         }
+	if (mem_heapsize() + mem_mapsize() != cursize || 
+	    i % RSS_SAMPLE == 0) {
+	    cursize = mem_heapsize() + mem_mapsize();
+	    if (cursize > heapsize)
+		heapsize = cursize;
+	    if ((rss = mem_resident()) > rss_peak)
+		rss_peak = rss;
+	}
+	if (series != NULL &&
+	    (i % series_ops == 0 || i == trace->num_ops - 1))
+	    sample_heap(series, tracenum, i, total_size);
+    }
+
+    /* Hand the trace's samples over in one append, whole lines only */
+    if (series != NULL) {
+	fclose(series);
+	write_all(series_fd, sbuf, slen);
+	free(sbuf);
     }
 
-    return ((double)max_total_size / (double)mem_heapsize());
+    stats->ifrag = (double)(max_usable - max_total_size) / heapsize;
+    stats->slab = (double)slab_bytes() / heapsize;
+    stats->heap_peak = heapsize;
+    stats->rss_peak = rss_peak;
+    stats->rss_end = mem_resident();
+    return ((double)max_total_size / (double)heapsize);
 }
 
 
+/*
+ * sample_heap - Write one line of the heap time series: the layout
+ *   that mm_heapinfo reports after op opnum of trace tracenum, when
+ *   payload bytes are live.  The waste splits into internal
+ *   fragmentation, allocated bytes beyond the payloads, and external
+ *   fragmentation, free bytes outside the largest free block.
+ */
+static void sample_heap(FILE *fp, int tracenum, int opnum, size_t payload)
+{
+    mm_heapinfo_t info;
+    int k;
+
+    mm_heapinfo(&info);
+    fprintf(fp, "%d,%d,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%zu", 
+	    tracenum, opnum, info.heap_bytes, payload, info.alloc_bytes,
+	    info.alloc_bytes - payload, info.free_bytes, info.largest_free,
+	    info.free_bytes - info.largest_free, info.free_blocks,
+	    info.slab_bytes, info.slab_free_bytes);
+    for (k = 0; k < MM_INFO_CLASSES; k++)
+	fprintf(fp, ",%zu", k < info.nclasses ? info.class_len[k] : 0);
+    for (k = 0; k < MM_INFO_BINS; k++)
+	fprintf(fp, ",%zu", info.free_hist[k]);
+    fprintf(fp, "\n");
+}
+
+/*
+ * open_series - Create the heap time series file and write its header.
+ *   It is opened for appending, so the workers of -j can each add
+ *   their traces' samples with one write apiece.
+ */
+static void open_series(char *file)
+{
+    char line[MAXLINE*2], *p = line;
+    int k;
+
+    if ((series_fd = open(file, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND,
+			  0644)) < 0) {
+	sprintf(msg, "Could not open %s", file);
+	unix_error(msg);
+    }
+    p += sprintf(p, "trace,op,heap,payload,alloc,internal,free,"
+		 "largest_free,external,free_blocks,slab,slab_free");
+    for (k = 0; k < MM_INFO_CLASSES; k++)
+	p += sprintf(p, ",len%d", k);
+    for (k = 0; k < MM_INFO_BINS; k++)
+	p += sprintf(p, ",hist%d", k);
+    p += sprintf(p, "\n");
+    write_all(series_fd, line, p - line);
+}
+
 /*
  * eval_mm_speed - This is the function that is used by fcyc()
  *    to measure the running time of the mm malloc package.
@@ -775,6 +1598,14 @@ static void eval_mm_speed(void *ptr)
             trace->blocks[index] = p;
             break;
 
+        case MEMALIGN: /* mm_memalign */
+            index = trace->ops[i].index;
+            size = trace->ops[i].size;
+            if ((p = mm_memalign(trace->ops[i].align, size)) == NULL)
+		app_error("mm_memalign error in eval_mm_speed");
+            trace->blocks[index] = p;
+            break;
+
 	case REALLOC: /* mm_realloc */
 	    index = trace->ops[i].index;
             newsize = trace->ops[i].size;
@@ -795,6 +1626,395 @@ static void eval_mm_speed(void *ptr)
         }
 }
 
+/*
+ * eval_mm_mt - Replay a trace through mm_mt on one thread and then on
+ *     nthreads threads, concurrently.  Each thread replays a copy of
+ *     the whole trace, or with partition set only the blocks whose
+ *     index is its own number mod nthreads.  Either way each thread
+ *     does the work of the single thread of the first run, so perfect
+ *     scaling would multiply the aggregate throughput by nthreads.
+ */
+static void eval_mm_mt(trace_t *trace, int nthreads, int partition,
+		       mtstats_t *stats)
+{
+    int ok1, ok, reps;
+
+    /* Replay the trace often enough to give every thread MT_OPS ops */
+    reps = MT_OPS / trace->num_ops + 1;
+
+    if ((stats->thread = (double *)calloc(nthreads, sizeof(double))) == NULL)
+	unix_error("calloc failed in eval_mm_mt");
+    mt_check();
+    stats->kops1 = mt_run(trace, 1, partition, reps, NULL, &ok1);
+    stats->kops = mt_run(trace, nthreads, partition, reps, stats->thread, &ok);
+    stats->ok = ok1 && ok;
+}
+
+/*
+ * mt_check - Before the timed runs, allocate and free memaligned
+ *     blocks smaller than any mm_mt size class on a fresh heap
+ */
+static void mt_check(void)
+{
+    char *p;
+    int i;
+
+    mem_reset_brk();
+    if (mm_mt_init() < 0)
+	app_error("mm_mt_init failed in mt_check");
+    for (i = 0; i < 2; i++) {
+	if ((p = mm_mt_memalign(i ? 8 : 64, 1)) == NULL)
+	    app_error("mm_mt_memalign failed in mt_check");
+	if ((size_t)p & (i ? 7 : 63))
+	    app_error("mm_mt_memalign returned a misaligned block");
+	mm_mt_free(p);
+    }
+}
+
+/*
+ * mt_run - Replay a trace on nthreads threads on a fresh heap, and
+ *     return the aggregate throughput in Kops/s.  Stores the throughput
+ *     of each thread in thread[] unless it is NULL, and sets *ok if
+ *     mm_mt satisfied every request.
+ */
+static double mt_run(trace_t *trace, int nthreads, int partition, int reps,
+		     double *thread, int *ok)
+{
+    pthread_t *tids;
+    mtarg_t *args;
+    pthread_barrier_t start;
+    double ops, secs;
+    int i;
+
+    /* Reset the heap and initialize the mm_mt package */
+    mem_reset_brk();
+    if (mm_mt_init() < 0)
+	app_error("mm_mt_init failed in mt_run");
+
+    tids = (pthread_t *)calloc(nthreads, sizeof(pthread_t));
+    args = (mtarg_t *)calloc(nthreads, sizeof(mtarg_t));
+    if (tids == NULL || args == NULL)
+	unix_error("calloc failed in mt_run");
+    pthread_barrier_init(&start, NULL, nthreads + 1);
+
+    for (i = 0; i < nthreads; i++) {
+	args[i].trace = trace;
+	args[i].id = i;
+	args[i].nthreads = nthreads;
+	args[i].partition = partition;
+	args[i].reps = reps;
+	args[i].start = &start;
+	if (pthread_create(&tids[i], NULL, mt_replay, &args[i]) != 0)
+	    app_error("pthread_create failed in mt_run");
+    }
+
+    /* Time from the moment every thread is ready until the last is done */
+    pthread_barrier_wait(&start);
+    secs = wall_secs();
+    for (i = 0; i < nthreads; i++)
+	pthread_join(tids[i], NULL);
+    secs = wall_secs() - secs;
+
+    ops = 0;
+    *ok = 1;
+    for (i = 0; i < nthreads; i++) {
+	ops += args[i].ops;
+	*ok = *ok && args[i].ok;
+	if (thread != NULL)
+	    thread[i] = args[i].ops / args[i].secs / 1e3;
+    }
+
+    pthread_barrier_destroy(&start);
+    free(tids);
+    free(args);
+    return ops / secs / 1e3;
+}
+
+/*
+ * mt_replay - The body of one replay thread.  Frees whatever the trace
+ *     leaves allocated after each pass, and stops early if mm_mt runs
+ *     out of memory.
+ */
+static void *mt_replay(void *ptr)
+{
+    mtarg_t *arg = (mtarg_t *)ptr;
+    trace_t *trace = arg->trace;
+    char **blocks, *p;
+    int r, i, index;
+
+    if ((blocks = (char **)calloc(trace->num_ids, sizeof(char *))) == NULL)
+	unix_error("calloc failed in mt_replay");
+    arg->ops = 0;
+    arg->ok = 1;
+
+    pthread_barrier_wait(arg->start);
+    arg->secs = wall_secs();
+    for (r = 0; r < arg->reps && arg->ok; r++) {
+	for (i = 0; i < trace->num_ops && arg->ok; i++) {
+	    index = trace->ops[i].index;
+	    if (arg->partition && index % arg->nthreads != arg->id)
+		continue;
+
+	    switch (trace->ops[i].type) {
+	    case ALLOC: /* mm_mt_malloc */
+		if ((p = mm_mt_malloc(trace->ops[i].size)) == NULL)
+		    arg->ok = 0;
+		blocks[index] = p;
+		break;
+
+	    case MEMALIGN: /* mm_mt_memalign */
+		p = mm_mt_memalign(trace->ops[i].align, trace->ops[i].size);
+		if (p == NULL)
+		    arg->ok = 0;
+		blocks[index] = p;
+		break;
+
+	    case REALLOC: /* mm_mt_realloc */
+		if ((p = mm_mt_realloc(blocks[index], trace->ops[i].size)) == NULL)
+		    arg->ok = 0;
+		else
+		    blocks[index] = p;
+		break;
+
+	    case FREE: /* mm_mt_free */
+		mm_mt_free(blocks[index]);
+		blocks[index] = NULL;
+		break;
+
+	    default:
+		app_error("Nonexistent request type in mt_replay");
+	    }
+	    arg->ops++;
+	}
+
+	for (index = 0; index < trace->num_ids; index++) {
+	    mm_mt_free(blocks[index]);
+	    blocks[index] = NULL;
+	}
+    }
+    arg->secs = wall_secs() - arg->secs;
+
+    free(blocks);
+    return NULL;
+}
+
+/*
+ * wall_secs - Return the time in seconds on a monotonic wall clock
+ */
+static double wall_secs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * eval_mm_region - Replay a trace as a server would run it: cut into
+ *     requests of about REGION_REQ bytes of allocations, with every
+ *     block of a request dying when it ends.  One replay frees the
+ *     blocks with mm_free, as the trace does and then the rest when
+ *     the request ends; the other allocates them from a region and
+ *     releases them with a single region_reset.
+ */
+static void eval_mm_region(trace_t *trace, regstats_t *stats)
+{
+    regarg_t free_arg, region_arg;
+    int *live;
+
+    if ((live = (int *)calloc(trace->num_ops, sizeof(int))) == NULL)
+	unix_error("calloc failed in eval_mm_region");
+    free_arg.trace = region_arg.trace = trace;
+    free_arg.live = region_arg.live = live;
+    free_arg.region = 0;
+    region_arg.region = 1;
+
+    /* Check that both fit in the heap before timing them */
+    region_replay(&free_arg);
+    region_replay(&region_arg);
+    stats->ok = free_arg.ok && region_arg.ok;
+    stats->reqs = region_arg.reqs;
+    stats->ops = trace->num_ops;
+    stats->region_peak = region_arg.peak;
+    if (stats->ok) {
+	stats->secs_free = fsecs(region_replay, &free_arg);
+	stats->secs_region = fsecs(region_replay, &region_arg);
+    }
+    free(live);
+}
+
+/*
+ * region_replay - Replay a trace in requests on a fresh heap, timed
+ *     by fsecs.  A realloc in a region is a new block and a copy.
+ *     Blocks that outlived their request are allocated anew by the
+ *     next realloc of their id, and their frees are dropped.
+ */
+static void region_replay(void *ptr)
+{
+    regarg_t *arg = (regarg_t *)ptr;
+    trace_t *trace = arg->trace;
+    region_t *r = NULL;
+    size_t bytes = 0;
+    int i, j, index, size, align, nlive = 0;
+    char *p, *oldp;
+
+    /* Reset the heap and initialize the mm package */
+    mem_reset_brk();
+    if (mm_init() < 0)
+	app_error("mm_init failed in region_replay");
+    arg->ok = 1;
+    arg->reqs = 0;
+    arg->peak = 0;
+    if (arg->region && (r = region_create(0)) == NULL) {
+	arg->ok = 0;
+	return;
+    }
+    memset(trace->blocks, 0, trace->num_ids * sizeof(char *));
+
+    for (i = 0; i < trace->num_ops && arg->ok; i++) {
+	index = trace->ops[i].index;
+	size = trace->ops[i].size;
+
+	switch (trace->ops[i].type) {
+	case ALLOC: /* mm_malloc or region_alloc */
+	case REALLOC: /* mm_realloc, or region_alloc and copy */
+	case MEMALIGN: /* mm_memalign, or region_alloc and round up */
+	    oldp = trace->blocks[index];
+	    align = trace->ops[i].type == MEMALIGN ? trace->ops[i].align : 0;
+	    if (!arg->region)
+		p = align ? mm_memalign(align, size) : 
+		    oldp ? mm_realloc(oldp, size) : mm_malloc(size);
+	    else if (align) {
+		if ((p = region_alloc(r, size + align - 1)) != NULL)
+		    p = (char *)(((size_t)p + align - 1) & ~(size_t)(align - 1));
+	    }
+	    else if ((p = region_alloc(r, size)) != NULL && oldp != NULL)
+		memcpy(p, oldp, MIN(size, trace->block_sizes[index]));
+	    if (p == NULL) {
+		arg->ok = 0;
+		break;
+	    }
+	    if (oldp == NULL)
+		arg->live[nlive++] = index;
+	    trace->blocks[index] = p;
+	    trace->block_sizes[index] = size;
+	    bytes += size;
+	    break;
+
+	case FREE: /* mm_free, or nothing until the request ends */
+	    if (!arg->region && trace->blocks[index] != NULL)
+		mm_free(trace->blocks[index]);
+	    trace->blocks[index] = NULL;
+	    break;
+
+	default:
+	    app_error("Nonexistent request type in region_replay");
+	}
+
+	/* End the request, releasing every block it still holds */
+	if (bytes >= REGION_REQ || i == trace->num_ops - 1) {
+	    for (j = 0; j < nlive; j++) {
+		index = arg->live[j];
+		if (!arg->region && trace->blocks[index] != NULL)
+		    mm_free(trace->blocks[index]);
+		trace->blocks[index] = NULL;
+	    }
+	    if (arg->region) {
+		arg->peak = MAX(arg->peak, region_bytes(r));
+		region_reset(r);
+	    }
+	    nlive = 0;
+	    bytes = 0;
+	    arg->reqs++;
+	}
+    }
+
+    if (arg->region)
+	region_destroy(r);
+}
+
+/*
+ * eval_mm_latency - Replay a trace through mm, on a fresh heap each
+ *     time, until at least LAT_OPS requests have been timed, and add
+ *     the cycles taken by every mm_malloc, mm_free, and mm_realloc call
+ *     to the histogram of its op type in hists[].
+ */
+static void eval_mm_latency(trace_t *trace, hist_t *hists)
+{
+    int i, r, reps, index;
+    unsigned long long t0, t1;
+    char *p;
+
+    reps = LAT_OPS / trace->num_ops + 1;
+    for (r = 0; r < reps; r++) {
+	mem_reset_brk();
+	if (mm_init() < 0) 
+	    app_error("mm_init failed in eval_mm_latency");
+
+	for (i = 0;  i < trace->num_ops;  i++) {
+	    index = trace->ops[i].index;
+	    switch (trace->ops[i].type) {
+
+	    case ALLOC: /* mm_malloc */
+		t0 = read_counter();
+		p = mm_malloc(trace->ops[i].size);
+		t1 = read_counter();
+		if (p == NULL)
+		    app_error("mm_malloc error in eval_mm_latency");
+		trace->blocks[index] = p;
+		break;
+
+	    case MEMALIGN: /* mm_memalign, counted as a malloc */
+		t0 = read_counter();
+		p = mm_memalign(trace->ops[i].align, trace->ops[i].size);
+		t1 = read_counter();
+		if (p == NULL)
+		    app_error("mm_memalign error in eval_mm_latency");
+		trace->blocks[index] = p;
+		break;
+
+	    case REALLOC: /* mm_realloc */
+		t0 = read_counter();
+		p = mm_realloc(trace->blocks[index], trace->ops[i].size);
+		t1 = read_counter();
+		if (p == NULL)
+		    app_error("mm_realloc error in eval_mm_latency");
+		trace->blocks[index] = p;
+		break;
+
+	    case FREE: /* mm_free */
+		t0 = read_counter();
+		mm_free(trace->blocks[index]);
+		t1 = read_counter();
+		break;
+
+	    default:
+		app_error("Nonexistent request type in eval_mm_latency");
+	    }
+	    hist_record(&hists[trace->ops[i].type == MEMALIGN ? 
+			       ALLOC : trace->ops[i].type], t1 - t0);
+	}
+    }
+}
+
+/*
+ * counter_ovhd - Return the fewest cycles seen between two back to
+ *     back reads of the cycle counter, which every latency includes
+ */
+static unsigned long long counter_ovhd(void)
+{
+    unsigned long long t0, d, best = ~0ULL;
+    int i;
+
+    for (i = 0; i < 1000; i++) {
+	t0 = read_counter();
+	d = read_counter() - t0;
+	if (d < best)
+	    best = d;
+    }
+    return best;
+}
+
 /*
  * eval_libc_valid - We run this function to make sure that the
  *    libc malloc can run to completion on the set of traces.
@@ -817,6 +2037,16 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
 	    trace->blocks[trace->ops[i].index] = p;
 	    break;
 
+        case MEMALIGN: /* posix_memalign */
+	    if ((errno = posix_memalign((void **)&p,
+					MAX(trace->ops[i].align, sizeof(void *)),
+					trace->ops[i].size)) != 0) {
+		malloc_error(tracenum, i, "libc posix_memalign failed");
+		unix_error("System message");
+	    }
+	    trace->blocks[trace->ops[i].index] = p;
+	    break;
+
 	case REALLOC: /* realloc */
             newsize = trace->ops[i].size;
 	    oldp = trace->blocks[trace->ops[i].index];
@@ -861,6 +2091,16 @@ static void eval_libc_speed(void *ptr)
 	    trace->blocks[index] = p;
 	    break;
 
+        case MEMALIGN: /* posix_memalign */
+	    index = trace->ops[i].index;
+	    size = trace->ops[i].size;
+	    if ((errno = posix_memalign((void **)&p,
+					MAX(trace->ops[i].align, sizeof(void *)),
+					size)) != 0)
+		unix_error("posix_memalign failed in eval_libc_speed");
+	    trace->blocks[index] = p;
+	    break;
+
 	case REALLOC: /* realloc */
 	    index = trace->ops[i].index;
 	    newsize = trace->ops[i].size;
@@ -886,7 +2126,9 @@ static void eval_libc_speed(void *ptr)
 
 
 /*
- * printresults - prints a performance summary for some malloc package
+ * printresults - prints a performance summary for some malloc package,
+ *     with the 95% confidence interval of each time as a percentage of
+ *     it when the timing method gives one
  */
 static void printresults(int n, stats_t *stats) 
 {
@@ -894,54 +2136,590 @@ static void printresults(int n, stats_t *stats)
     double secs = 0;
     double ops = 0;
     double util = 0;
+    double var = 0;
 
     /* Print the individual results for each trace */
-    printf("%5s%7s %5s%8s%10s%6s\n", 
-	   "trace", " valid", "util", "ops", "secs", "Kops");
+    printf("%5s%7s %5s%8s%10s%8s%7s\n", 
+	   "trace", " valid", "util", "ops", "secs", "Kops", "+/-");
     for (i=0; i < n; i++) {
 	if (stats[i].valid) {
-	    printf("%2d%10s%5.0f%%%8.0f%10.6f%6.0f\n", 
+	    printf("%2d%10s%5.0f%%%8.0f%10.6f%8.0f", 
 		   i,
 		   "yes",
 		   stats[i].util*100.0,
 		   stats[i].ops,
 		   stats[i].secs,
 		   (stats[i].ops/1e3)/stats[i].secs);
+	    if (stats[i].ci > 0)
+		printf("%6.1f%%\n", 100.0*stats[i].ci/stats[i].secs);
+	    else
+		printf("%7s\n", "-");
 	    secs += stats[i].secs;
 	    ops += stats[i].ops;
 	    util += stats[i].util;
+	    var += stats[i].ci * stats[i].ci;
 	}
 	else {
-	    printf("%2d%10s%6s%8s%10s%6s\n", 
+	    printf("%2d%10s%6s%8s%10s%8s%7s\n", 
 		   i,
 		   "no",
 		   "-",
 		   "-",
 		   "-",
+		   "-",
 		   "-");
 	}
     }
 
     /* Print the aggregate results for the set of traces */
     if (errors == 0) {
-	printf("%12s%5.0f%%%8.0f%10.6f%6.0f\n", 
+	printf("%12s%5.0f%%%8.0f%10.6f%8.0f", 
 	       "Total       ",
 	       (util/n)*100.0,
 	       ops, 
 	       secs,
 	       (ops/1e3)/secs);
+	/* The traces were timed independently, so their variances add */
+	if (var > 0)
+	    printf("%6.1f%%\n", 100.0*sqrt(var)/secs);
+	else
+	    printf("%7s\n", "-");
     }
     else {
-	printf("%12s%6s%8s%10s%6s\n", 
+	printf("%12s%6s%8s%10s%8s%7s\n", 
 	       "Total       ",
 	       "-", 
 	       "-", 
 	       "-", 
+	       "-",
 	       "-");
     }
 
 }
 
+/*
+ * printfrag - prints where the heap went at its high water mark: the
+ *     payloads themselves (util), internal fragmentation, and pages
+ *     held by the slab allocator; then how much of it was resident at
+ *     peak and at the end of the trace
+ */
+static void printfrag(int n, stats_t *stats)
+{
+    int i;
+
+    printf("\nHeap breakdown:\n");
+    printf("%5s%7s%7s%7s%10s%10s\n", 
+	   "trace", "util", "ifrag", "slab", "peakRSS", "endRSS");
+    for (i = 0; i < n; i++) {
+	if (!stats[i].valid)
+	    continue;
+	printf("%2d%9.0f%%%6.1f%%%6.0f%%%9.0fK%9.0fK\n",
+	       i, stats[i].util*100.0, stats[i].ifrag*100.0,
+	       stats[i].slab*100.0, stats[i].rss_peak/1024, 
+	       stats[i].rss_end/1024);
+    }
+}
+
+/*
+ * printreallocs - prints how often each mm_realloc path ran, for the
+ *     traces that call realloc at all
+ */
+static void printreallocs(int n, stats_t *stats)
+{
+    int i;
+    mm_realloc_stats_t *r;
+
+    for (i = 0; i < n; i++)
+	if (stats[i].valid && (stats[i].realloc.shrink + stats[i].realloc.fit +
+			       stats[i].realloc.grow + stats[i].realloc.extend +
+			       stats[i].realloc.copy))
+	    break;
+    if (i == n)
+	return;
+
+    printf("\nRealloc paths:\n");
+    printf("%5s%8s%8s%8s%8s%8s\n",
+	   "trace", "shrink", "fit", "grow", "extend", "copy");
+    for (i = 0; i < n; i++) {
+	r = &stats[i].realloc;
+	if (!stats[i].valid ||
+	    (r->shrink + r->fit + r->grow + r->extend + r->copy) == 0)
+	    continue;
+	printf("%2d%11lu%8lu%8lu%8lu%8lu\n",
+	       i, r->shrink, r->fit, r->grow, r->extend, r->copy);
+    }
+}
+
+/*
+ * printmt - prints the aggregate throughput of the threaded replay of
+ *     each trace on one thread and on nthreads threads, the scaling
+ *     efficiency (how close nthreads came to nthreads times one thread),
+ *     and the slowest and fastest thread
+ */
+static void printmt(int n, mtstats_t *stats, int nthreads, int partition)
+{
+    int i, j, count = 0;
+    double min, max, kops1 = 0, kops = 0;
+    char hdr[MAXLINE];
+
+    printf("\nThreaded replay on %d threads (%s):\n", nthreads,
+	   partition ? "trace split among threads" : "a copy per thread");
+    snprintf(hdr, sizeof(hdr), "Kops(%d)", nthreads);
+    printf("%5s%10s%10s%7s%9s%9s\n",
+	   "trace", "Kops(1)", hdr, "eff", "thrmin", "thrmax");
+    for (i = 0; i < n; i++) {
+	if (stats[i].thread == NULL)
+	    continue;
+	if (!stats[i].ok) {
+	    printf("%2d%18s (raise MAX_HEAP or use -P)\n", i, "out of memory");
+	    continue;
+	}
+	min = max = stats[i].thread[0];
+	for (j = 1; j < nthreads; j++) {
+	    min = MIN(min, stats[i].thread[j]);
+	    max = MAX(max, stats[i].thread[j]);
+	}
+	printf("%2d%13.0f%10.0f%6.0f%%%9.0f%9.0f\n", i, stats[i].kops1,
+	       stats[i].kops, 100.0 * stats[i].kops / (nthreads*stats[i].kops1),
+	       min, max);
+	if (verbose > 1) {
+	    for (j = 0; j < nthreads; j++)
+		printf("%s%.0f", (j % 8) ? " " : "    threads: ",
+		       stats[i].thread[j]);
+	    printf("\n");
+	}
+	kops1 += stats[i].kops1;
+	kops += stats[i].kops;
+	count++;
+    }
+    if (count > 0)
+	printf("%5s%10.0f%10.0f%6.0f%%\n", "Avg", kops1/count, kops/count,
+	       100.0 * kops / (nthreads*kops1));
+}
+
+/*
+ * printregion - prints the throughput of each trace replayed in
+ *     requests, freeing every block with mm_free and releasing each
+ *     request's blocks at once with region_reset, and the speedup
+ */
+static void printregion(int n, regstats_t *stats)
+{
+    int i, count = 0;
+    double kops_free, kops_region, ops = 0, secs_free = 0, secs_region = 0;
+
+    printf("\nRequests of %d KB, mm_free vs region_reset:\n", REGION_REQ >> 10);
+    printf("%5s%8s%12s%12s%9s%10s\n",
+	   "trace", "reqs", "Kops(free)", "Kops(reg)", "speedup", "regpeak");
+    for (i = 0; i < n; i++) {
+	if (stats[i].reqs == 0)
+	    continue;
+	if (!stats[i].ok) {
+	    printf("%2d%21s\n", i, "out of memory");
+	    continue;
+	}
+	kops_free = stats[i].ops / stats[i].secs_free / 1e3;
+	kops_region = stats[i].ops / stats[i].secs_region / 1e3;
+	printf("%2d%11d%12.0f%12.0f%8.2fx%9.0fK\n", i, stats[i].reqs,
+	       kops_free, kops_region, kops_region / kops_free,
+	       stats[i].region_peak / 1024);
+	ops += stats[i].ops;
+	secs_free += stats[i].secs_free;
+	secs_region += stats[i].secs_region;
+	count++;
+    }
+    if (count > 0)
+	printf("%5s%8s%12.0f%12.0f%8.2fx\n", "Total", "",
+	       ops / secs_free / 1e3, ops / secs_region / 1e3,
+	       secs_free / secs_region);
+}
+
+/*
+ * printlatency - prints the latency percentiles of each request type
+ *     of each trace, and of all traces together, in counter cycles.
+ *     If histfile is not NULL, also writes every histogram to it.
+ */
+static void printlatency(int n, hist_t *hists, char **tracefiles, 
+			 char *histfile)
+{
+    static char *names[] = {"malloc", "free", "realloc"};
+    hist_t *all, *h;
+    FILE *fp = NULL;
+    char title[MAXLINE];
+    int i, type;
+
+    if ((all = (hist_t *)calloc(3, sizeof(hist_t))) == NULL)
+	unix_error("calloc failed in printlatency");
+    if (histfile != NULL && (fp = fopen(histfile, "w")) == NULL) {
+	snprintf(msg, MAXLINE, "Could not open %s in printlatency", histfile);
+	unix_error(msg);
+    }
+
+    printf("\nLatency in cycles (counter overhead %llu):\n", counter_ovhd());
+    printf("%5s %-8s%10s%8s%8s%8s%8s%10s\n", 
+	   "trace", "op", "count", "p50", "p90", "p99", "p99.9", "max");
+    for (i = 0; i <= n; i++) {
+	for (type = 0; type < 3; type++) {
+	    h = (i < n) ? &hists[3*i + type] : &all[type];
+	    if (h->count == 0)
+		continue;
+	    if (i < n) {
+		hist_merge(&all[type], h);
+		printf("%2d%3s %-8s", i, "", names[type]);
+		snprintf(title, MAXLINE, "trace %d (%s) %s", 
+			 i, tracefiles[i], names[type]);
+	    }
+	    else {
+		printf("%5s %-8s", "Total", names[type]);
+		snprintf(title, MAXLINE, "all traces %s", names[type]);
+	    }
+	    printf("%10llu%8llu%8llu%8llu%8llu%10llu\n", h->count,
+		   hist_percentile(h, 50), hist_percentile(h, 90),
+		   hist_percentile(h, 99), hist_percentile(h, 99.9), h->max);
+	    if (fp != NULL)
+		hist_print(fp, h, title);
+	}
+    }
+
+    if (fp != NULL)
+	fclose(fp);
+    free(all);
+}
+
+/*
+ * printpages - prints the throughput of each trace on base pages and
+ *     on the pages of kind that backed the main run, and with counters
+ *     its dTLB misses and page faults per op, each with the change
+ *     from base pages
+ */
+static void printpages(int n, stats_t *base, stats_t *stats, int kind,
+		       int counters)
+{
+    int i;
+    double bsecs = 0, secs = 0, ops = 0;
+    perf_counts_t *bp, *pc;
+
+    printf("\nBase pages against %s pages:\n", page_kinds[kind]);
+    printf("%5s%25s", "", "Kops");
+    if (counters)
+	printf("%25s%25s", "tlbmiss/op", "faults/op");
+    printf("\n%5s", "trace");
+    for (i = 0; i < (counters ? 3 : 1); i++)
+	printf("%9s%9s%7s", "base", page_kinds[kind], "change");
+    printf("\n");
+    for (i = 0; i < n; i++) {
+	if (!base[i].valid || !stats[i].valid)
+	    continue;
+	printf("%2d   ", i);
+	printchange((base[i].ops/1e3)/base[i].secs,
+		    (stats[i].ops/1e3)/stats[i].secs, 1, "%9.0f");
+	if (counters) {
+	    bp = &base[i].perf;
+	    pc = &stats[i].perf;
+	    printchange(bp->count[PERF_DTLB_MISSES] / base[i].ops,
+			pc->count[PERF_DTLB_MISSES] / stats[i].ops,
+			bp->valid[PERF_DTLB_MISSES] &&
+			pc->valid[PERF_DTLB_MISSES], "%9.3f");
+	    printchange(bp->count[PERF_PAGE_FAULTS] / base[i].ops,
+			pc->count[PERF_PAGE_FAULTS] / stats[i].ops,
+			bp->valid[PERF_PAGE_FAULTS] &&
+			pc->valid[PERF_PAGE_FAULTS], "%9.3f");
+	}
+	printf("\n");
+	bsecs += base[i].secs;
+	secs += stats[i].secs;
+	ops += stats[i].ops;
+    }
+    if (bsecs > 0 && secs > 0) {
+	printf("%-5s", "Total");
+	printchange((ops/1e3)/bsecs, (ops/1e3)/secs, 1, "%9.0f");
+	printf("\n");
+    }
+}
+
+/*
+ * printchange - prints a base value, a value, and the change from one
+ *     to the other in percent, or "-" for each if they are not valid
+ */
+static void printchange(double base, double val, int valid, char *fmt)
+{
+    if (!valid) {
+	printf("%9s%9s%7s", "-", "-", "-");
+	return;
+    }
+    printf(fmt, base);
+    printf(fmt, val);
+    if (base > 0)
+	printf("%+6.1f%%", 100.0*(val - base)/base);
+    else
+	printf("%7s", "-");
+}
+
+/*
+ * printperf - prints the instructions per cycle of each trace's speed
+ *     run and the events per op that the hardware counters saw, or "-"
+ *     for the events that could not be counted
+ */
+static void printperf(int n, stats_t *stats)
+{
+    static int cols[] = {PERF_INSTRUCTIONS, PERF_CACHE_MISSES,
+			 PERF_BRANCH_MISSES, PERF_DTLB_MISSES, 
+			 PERF_PAGE_FAULTS};
+    perf_counts_t *pc;
+    int i, j;
+
+    printf("\nHardware counters per op:\n");
+    printf("%5s%7s%9s%9s%9s%9s%9s\n", 
+	   "trace", "IPC", "instr", "cmiss", "bmiss", "tlbmiss", "faults");
+    for (i = 0; i < n; i++) {
+	if (!stats[i].valid)
+	    continue;
+	pc = &stats[i].perf;
+	printf("%2d", i);
+	if (pc->valid[PERF_CYCLES] && pc->valid[PERF_INSTRUCTIONS] &&
+	    pc->count[PERF_CYCLES] > 0)
+	    printf("%10.2f", 
+		   pc->count[PERF_INSTRUCTIONS] / pc->count[PERF_CYCLES]);
+	else
+	    printf("%10s", "-");
+	for (j = 0; j < sizeof(cols) / sizeof(cols[0]); j++) {
+	    if (pc->valid[cols[j]])
+		printf("%9.3f", pc->count[cols[j]] / stats[i].ops);
+	    else
+		printf("%9s", "-");
+	}
+	printf("\n");
+    }
+}
+
+/*
+ * write_results - writes the mm results of each trace, and their
+ *     latency percentiles if hists is not NULL, to file: as CSV with a
+ *     header row if file ends in ".csv", and otherwise as JSON with one
+ *     trace per line.  compare_baseline reads both back.
+ */
+static void write_results(char *file, int n, char **tracefiles, 
+			  stats_t *stats, hist_t *hists)
+{
+    static char *names[] = {"malloc", "free", "realloc"};
+    static double pcts[] = {50, 90, 99, 99.9};
+    static char *pctnames[] = {"p50", "p90", "p99", "p99.9"};
+    size_t len = strlen(file);
+    int csv = (len >= 4 && strcmp(file + len - 4, ".csv") == 0);
+    int i, j, type;
+    hist_t *h;
+    FILE *fp;
+
+    if ((fp = fopen(file, "w")) == NULL) {
+	snprintf(msg, MAXLINE, "Could not open %s in write_results", file);
+	unix_error(msg);
+    }
+
+    if (csv) {
+	fprintf(fp, "trace,valid,ops,secs,ci,kops,util,heap_peak,rss_peak");
+	for (type = 0; type < 3; type++) {
+	    for (j = 0; j < 4; j++)
+		fprintf(fp, ",%s_%s", names[type], pctnames[j]);
+	    fprintf(fp, ",%s_max", names[type]);
+	}
+	fprintf(fp, "\n");
+    }
+    else
+	fprintf(fp, "{\"traces\": [\n");
+
+    for (i = 0; i < n; i++) {
+	if (csv)
+	    fprintf(fp, "%s,%d,%.0f,%.9f,%.9f,%.3f,%.6f,%.0f,%.0f", 
+		    tracefiles[i], stats[i].valid, stats[i].ops, 
+		    stats[i].secs, stats[i].ci, 
+		    stats[i].valid ? (stats[i].ops/1e3)/stats[i].secs : 0,
+		    stats[i].util, stats[i].heap_peak, stats[i].rss_peak);
+	else
+	    fprintf(fp, "  {\"trace\": \"%s\", \"valid\": %s, \"ops\": %.0f, "
+		    "\"secs\": %.9f, \"ci\": %.9f, \"kops\": %.3f, "
+		    "\"util\": %.6f, \"heap_peak\": %.0f, \"rss_peak\": %.0f",
+		    tracefiles[i], stats[i].valid ? "true" : "false", 
+		    stats[i].ops, stats[i].secs, stats[i].ci,
+		    stats[i].valid ? (stats[i].ops/1e3)/stats[i].secs : 0,
+		    stats[i].util, stats[i].heap_peak, stats[i].rss_peak);
+
+	/* Latency percentiles in cycles, left empty without -L */
+	if (!csv && hists != NULL)
+	    fprintf(fp, ", \"latency\": {");
+	for (type = 0; type < 3; type++) {
+	    h = (hists != NULL) ? &hists[3*i + type] : NULL;
+	    if (csv) {
+		for (j = 0; j < 4; j++) {
+		    if (h != NULL && h->count > 0)
+			fprintf(fp, ",%llu", hist_percentile(h, pcts[j]));
+		    else
+			fprintf(fp, ",");
+		}
+		if (h != NULL && h->count > 0)
+		    fprintf(fp, ",%llu", h->max);
+		else
+		    fprintf(fp, ",");
+	    }
+	    else if (h != NULL) {
+		fprintf(fp, "%s\"%s\": {\"count\": %llu", 
+			type ? ", " : "", names[type], h->count);
+		if (h->count > 0) {
+		    for (j = 0; j < 4; j++)
+			fprintf(fp, ", \"%s\": %llu", pctnames[j],
+				hist_percentile(h, pcts[j]));
+		    fprintf(fp, ", \"max\": %llu", h->max);
+		}
+		fprintf(fp, "}");
+	    }
+	}
+	if (csv)
+	    fprintf(fp, "\n");
+	else
+	    fprintf(fp, "%s}%s\n", hists != NULL ? "}" : "", 
+		    i < n - 1 ? "," : "");
+    }
+
+    if (!csv)
+	fprintf(fp, "]}\n");
+    fclose(fp);
+}
+
+/*
+ * baseline_field - Copy field name of a baseline line into buf: for a
+ *     JSON line, the value of "name"; for a CSV line, the column whose
+ *     header is name.  Returns 0 if the line has no such field.
+ */
+static int baseline_field(char *line, char *header, char *name, 
+			  char *buf, int size)
+{
+    char key[MAXLINE], *p, *q;
+    int col, k;
+
+    if (header == NULL) {       /* JSON */
+	snprintf(key, MAXLINE, "\"%s\":", name);
+	if ((p = strstr(line, key)) == NULL)
+	    return 0;
+	p += strlen(key);
+	p += strspn(p, " \"");
+	k = strcspn(p, "\",}");
+    }
+    else {                      /* CSV: find the column, then the field */
+	for (col = 0, p = header; ; col++) {
+	    k = strcspn(p, ",\r\n");
+	    if (k == strlen(name) && strncmp(p, name, k) == 0)
+		break;
+	    if (p[k] != ',')
+		return 0;
+	    p += k + 1;
+	}
+	for (p = line; col > 0; col--) {
+	    if ((q = strchr(p, ',')) == NULL)
+		return 0;
+	    p = q + 1;
+	}
+	k = strcspn(p, ",\r\n");
+    }
+    snprintf(buf, size, "%.*s", k, p);
+    return 1;
+}
+
+/*
+ * compare_baseline - Prints the change in Kops and util of each trace
+ *     against the same trace in file, a baseline written by -o, and
+ *     returns how many traces lost more than pct percent of either,
+ *     or -1 if no trace of this run is in the baseline.  A trace that
+ *     is in the baseline but failed this run counts as lost.  A drop
+ *     in Kops counts only if the two times differ by more than their
+ *     confidence intervals allow, where both runs have one.
+ */
+static int compare_baseline(char *file, int n, char **tracefiles,
+			    stats_t *stats, double pct)
+{
+    char line[4*MAXLINE], header[4*MAXLINE], name[MAXLINE], val[MAXLINE];
+    double *base_kops, *base_util, *base_secs, *base_ci, kops, dk, du;
+    int i, csv = -1, found, bad = 0, slower, noise;
+    FILE *fp;
+
+    if ((fp = fopen(file, "r")) == NULL) {
+	snprintf(msg, MAXLINE, "Could not open baseline %s", file);
+	unix_error(msg);
+    }
+    base_kops = (double *)calloc(n, sizeof(double));
+    base_util = (double *)calloc(n, sizeof(double));
+    base_secs = (double *)calloc(n, sizeof(double));
+    base_ci = (double *)calloc(n, sizeof(double));
+    if (base_kops == NULL || base_util == NULL || base_secs == NULL ||
+	base_ci == NULL)
+	unix_error("calloc failed in compare_baseline");
+
+    /* Pick out the baseline traces that are also in this run */
+    while (fgets(line, sizeof(line), fp) != NULL) {
+	if (csv < 0) {
+	    csv = (line[strspn(line, " \t")] != '{');
+	    if (csv) {
+		strcpy(header, line);
+		continue;
+	    }
+	}
+	if (!baseline_field(line, csv ? header : NULL, "trace", 
+			    name, MAXLINE))
+	    continue;
+	for (i = 0; i < n && strcmp(tracefiles[i], name) != 0; i++)
+	    ;
+	if (i == n)
+	    continue;
+	if (baseline_field(line, csv ? header : NULL, "kops", val, MAXLINE))
+	    base_kops[i] = atof(val);
+	if (baseline_field(line, csv ? header : NULL, "util", val, MAXLINE))
+	    base_util[i] = atof(val);
+	if (baseline_field(line, csv ? header : NULL, "secs", val, MAXLINE))
+	    base_secs[i] = atof(val);
+	if (baseline_field(line, csv ? header : NULL, "ci", val, MAXLINE))
+	    base_ci[i] = atof(val);
+    }
+    fclose(fp);
+
+    printf("\nCompared with baseline %s (flagging drops over %g%%):\n", 
+	   file, pct);
+    printf("%5s%10s%10s%8s%7s%7s%8s\n",
+	   "trace", "Kops", "base", "change", "util", "base", "change");
+    for (i = found = 0; i < n; i++) {
+	if (base_kops[i] <= 0)
+	    continue;
+	found++;
+	if (!stats[i].valid) {
+	    printf("%2d%13s%10.0f%8s%7s%6.0f%%%8s  REGRESSED\n",
+		   i, "-", base_kops[i], "-", "-", base_util[i]*100.0, "-");
+	    bad++;
+	    continue;
+	}
+	kops = (stats[i].ops/1e3)/stats[i].secs;
+	dk = 100.0 * (kops - base_kops[i]) / base_kops[i];
+	du = (base_util[i] > 0) ? 
+	    100.0 * (stats[i].util - base_util[i]) / base_util[i] : 0;
+	slower = (dk < -pct);
+	noise = slower && stats[i].ci > 0 && base_ci[i] > 0 &&
+	    stats[i].secs - base_secs[i] <= 
+	    sqrt(stats[i].ci*stats[i].ci + base_ci[i]*base_ci[i]);
+	printf("%2d%13.0f%10.0f%+7.1f%%%6.0f%%%6.0f%%%+7.1f%%%s\n",
+	       i, kops, base_kops[i], dk, stats[i].util*100.0, 
+	       base_util[i]*100.0, du, 
+	       ((slower && !noise) || du < -pct) ? "  REGRESSED" : 
+	       noise ? "  (within noise)" : "");
+	if ((slower && !noise) || du < -pct)
+	    bad++;
+    }
+    if (found == 0) {
+	printf("No trace of this run is in the baseline\n");
+	bad = -1;
+    }
+
+    free(base_kops);
+    free(base_util);
+    free(base_secs);
+    free(base_ci);
+    return bad;
+}
+
 /* 
  * app_error - Report an arbitrary application error
  */
@@ -974,13 +2752,34 @@ void malloc_error(int tracenum, int opnum, char *msg)
  */
 static void usage(void) 
 {
-    fprintf(stderr, "Usage: mdriver [-hvVal] [-f <file>] [-t <dir>]\n");
+    fprintf(stderr, "Usage: mdriver [-hvVaclLPCR] [-f <file>] [-t <dir>] [-m <n>] [-T <n>]\n");
+    fprintf(stderr, "               [-H <file>] [-j <n>] [-o <file>] [-b <file>] [-r <pct>]\n");
+    fprintf(stderr, "               [-s <n>] [-S <file>] [-p <pages>]\n");
     fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-b <file>  Compare with baseline <file>; exit 2 on a regression\n");
+    fprintf(stderr, "\t           or an error, or if no trace is in <file>.\n");
+    fprintf(stderr, "\t-c         Also run on base pages, and print the change to the\n");
+    fprintf(stderr, "\t           -p pages (thp if none) in Kops, and with -C dTLB misses.\n");
+    fprintf(stderr, "\t-C         Report hardware counter events per op.\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
     fprintf(stderr, "\t-g         Generate summary info for autograder.\n");
     fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-H <file>  Like -L, and dump the histograms to <file>.\n");
+    fprintf(stderr, "\t-j <n>     Evaluate <n> traces at once (0: one per core).\n");
     fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+    fprintf(stderr, "\t-L         Report latency percentiles of each request type.\n");
+    fprintf(stderr, "\t-m <n>     Use mmap for blocks of at least <n> bytes.\n");
+    fprintf(stderr, "\t-o <file>  Write results as JSON, or CSV if <file> ends in .csv.\n");
+    fprintf(stderr, "\t-p <pages> Back the heap with base, thp, or hugetlb pages.\n");
+    fprintf(stderr, "\t-P         With -T, split each trace among the threads.\n");
+    fprintf(stderr, "\t-R         Also time releasing blocks per request with regions.\n");
+    fprintf(stderr, "\t-r <pct>   With -b, flag drops of over <pct>%% (default %d).\n",
+	    REGRESS_PCT);
+    fprintf(stderr, "\t-s <n>     Sample the heap layout every <n> ops of each trace.\n");
+    fprintf(stderr, "\t-S <file>  With -s, write the samples to <file> (default %s).\n",
+	    SERIES_FILE);
     fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
+    fprintf(stderr, "\t-T <n>     Also replay each trace on <n> threads via mm_mt.\n");
     fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
     fprintf(stderr, "\t-V         Print additional debug info.\n");
 }
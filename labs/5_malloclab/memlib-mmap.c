@@ -0,0 +1,306 @@
+/*
+ * memlib-mmap.c - memlib.h over real memory, for running the allocator
+ *     as a program's own malloc (see mmpreload.c).
+ *
+ * mem_init reserves MAX_HEAP bytes of address space with mmap, without
+ * committing swap for them, and mem_sbrk moves a break through that
+ * reservation just as memlib.c does.  Unlike memlib.c this module never
+ * calls malloc or stdio, since it sits underneath them: the records of
+ * mem_map regions come from a pool of mmap'd pages, and failures are
+ * reported only through errno and the return value.
+ *
+ * Callers serialize access; nothing here takes a lock.
+ */
+#define _GNU_SOURCE            /* for mremap */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <errno.h>
+
+#include "memlib.h"
+#include "config.h"
+
+/* Records one region handed out by mem_map */
+typedef struct region_t {
+    char *lo;               /* first byte of the mapping */
+    size_t size;            /* length of the mapping in bytes */
+    struct region_t *next;  /* next list element */
+} region_t;
+
+/* private variables */
+static char *mem_start_brk;  /* points to first byte of heap */
+static char *mem_brk;        /* points to last byte of heap */
+static char *mem_max_addr;   /* largest legal heap address */
+static size_t mem_page;      /* system page size */
+static region_t *mem_regions;  /* regions outside the heap from mem_map */
+static region_t *free_records; /* unused region records */
+static size_t mem_map_bytes;   /* total bytes in those regions */
+static size_t mem_threshold = MMAP_THRESHOLD; /* see mem_map_threshold */
+
+/* private helper routines */
+static region_t *new_record(void);
+static size_t page_round(size_t size);
+
+/*
+ * mem_init - reserve the address space for the heap
+ */
+void mem_init(void)
+{
+    mem_page = (size_t)getpagesize();
+    mem_start_brk = mmap(NULL, MAX_HEAP, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mem_start_brk == MAP_FAILED) {
+	mem_start_brk = NULL;
+	return;
+    }
+    mem_max_addr = mem_start_brk + MAX_HEAP;
+    mem_brk = mem_start_brk;
+}
+
+/*
+ * mem_deinit - give the heap and every mem_map region back
+ */
+void mem_deinit(void)
+{
+    mem_reset_brk();
+    munmap(mem_start_brk, MAX_HEAP);
+    mem_start_brk = mem_brk = mem_max_addr = NULL;
+}
+
+/*
+ * mem_reset_brk - empty the heap and unmap every region from mem_map
+ */
+void mem_reset_brk()
+{
+    region_t *r;
+
+    mem_release(mem_start_brk, mem_brk - mem_start_brk);
+    mem_brk = mem_start_brk;
+    while ((r = mem_regions) != NULL) {
+	mem_regions = r->next;
+	munmap(r->lo, r->size);
+	r->next = free_records;
+	free_records = r;
+    }
+    mem_map_bytes = 0;
+}
+
+/*
+ * mem_sbrk - extend the heap by incr bytes and return the start address
+ *    of the new area, or shrink it and release the pages it gave up
+ */
+void *mem_sbrk(int incr)
+{
+    char *old_brk = mem_brk;
+
+    if (mem_start_brk == NULL || (mem_brk + incr) > mem_max_addr) {
+	errno = ENOMEM;
+	return (void *)-1;
+    }
+    if ((mem_brk + incr) < mem_start_brk) {
+	errno = EINVAL;
+	return (void *)-1;
+    }
+    mem_brk += incr;
+    if (incr < 0)
+	mem_release(mem_brk, -incr);
+    return (void *)old_brk;
+}
+
+/*
+ * mem_release - hand the whole pages inside [lo, lo+len) back to the
+ *    system; they read as zeros when next touched
+ */
+void mem_release(void *lo, size_t len)
+{
+    char *start = (char *)(((size_t)lo + mem_page - 1) & ~(mem_page - 1));
+    char *end = (char *)(((size_t)lo + len) & ~(mem_page - 1));
+
+    if (start < end)
+	madvise(start, end - start, MADV_DONTNEED);
+}
+
+/*
+ * mem_resident - not tracked for a real heap; always returns 0
+ */
+size_t mem_resident()
+{
+    return 0;
+}
+
+/*
+ * mem_heap_lo - return address of the first heap byte
+ */
+void *mem_heap_lo()
+{
+    return (void *)mem_start_brk;
+}
+
+/*
+ * mem_heap_hi - return address of last heap byte
+ */
+void *mem_heap_hi()
+{
+    return (void *)(mem_brk - 1);
+}
+
+/*
+ * mem_heapsize() - returns the heap size in bytes
+ */
+size_t mem_heapsize()
+{
+    return (size_t)(mem_brk - mem_start_brk);
+}
+
+/*
+ * mem_pagesize() - returns the page size of the system
+ */
+size_t mem_pagesize()
+{
+    return mem_page;
+}
+
+/*
+ * mem_map - give the allocator a page-aligned region of at least size
+ *    bytes of its own, outside the heap
+ */
+void *mem_map(size_t size)
+{
+    region_t *r;
+    void *p;
+
+    if ((r = new_record()) == NULL) {
+	errno = ENOMEM;
+	return (void *)-1;
+    }
+    size = page_round(size);
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+	     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+	r->next = free_records;
+	free_records = r;
+	errno = ENOMEM;
+	return (void *)-1;
+    }
+    r->lo = p;
+    r->size = size;
+    r->next = mem_regions;
+    mem_regions = r;
+    mem_map_bytes += size;
+    return p;
+}
+
+/*
+ * mem_remap - resize the region at lo to at least size bytes, possibly
+ *    moving it. Returns the new start of the region, or (void *)-1 if
+ *    it cannot be resized, in which case it is left alone.
+ */
+void *mem_remap(void *lo, size_t size)
+{
+    region_t *r;
+    void *p;
+
+    for (r = mem_regions; r != NULL && r->lo != lo; r = r->next)
+	;
+    if (r == NULL)
+	return (void *)-1;
+
+    size = page_round(size);
+    if ((p = mremap(r->lo, r->size, size, MREMAP_MAYMOVE)) == MAP_FAILED)
+	return (void *)-1;
+    mem_map_bytes += size - r->size;
+    r->lo = p;
+    r->size = size;
+    return p;
+}
+
+/*
+ * mem_unmap - return the region at lo, from mem_map, to the system
+ */
+void mem_unmap(void *lo)
+{
+    region_t *r, **prevpp;
+
+    for (prevpp = &mem_regions; (r = *prevpp) != NULL; prevpp = &r->next) {
+	if (r->lo == lo) {
+	    *prevpp = r->next;
+	    munmap(r->lo, r->size);
+	    mem_map_bytes -= r->size;
+	    r->next = free_records;
+	    free_records = r;
+	    return;
+	}
+    }
+}
+
+/*
+ * mem_is_mapped - is [lo, hi] inside a single region from mem_map?
+ */
+int mem_is_mapped(void *lo, void *hi)
+{
+    region_t *r;
+
+    for (r = mem_regions; r != NULL; r = r->next)
+	if ((char *)lo >= r->lo && (char *)hi < r->lo + r->size)
+	    return 1;
+    return 0;
+}
+
+/*
+ * mem_mapsize - returns the total bytes in regions from mem_map
+ */
+size_t mem_mapsize()
+{
+    return mem_map_bytes;
+}
+
+/*
+ * mem_map_threshold - requests of at least this many bytes should be
+ *    given a region of their own with mem_map instead of heap space
+ */
+size_t mem_map_threshold()
+{
+    return mem_threshold;
+}
+
+/*
+ * mem_set_map_threshold - change the value returned by
+ *    mem_map_threshold; takes effect at the allocator's next init
+ */
+void mem_set_map_threshold(size_t size)
+{
+    mem_threshold = size;
+}
+
+/*
+ * new_record - take an unused region record, mapping a page of fresh
+ *    ones when there are none left
+ */
+static region_t *new_record(void)
+{
+    region_t *r;
+    size_t i, n = mem_page / sizeof(region_t);
+
+    if (free_records == NULL) {
+	r = mmap(NULL, mem_page, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (r == MAP_FAILED)
+	    return NULL;
+	for (i = 0; i < n; i++) {
+	    r[i].next = free_records;
+	    free_records = &r[i];
+	}
+    }
+    r = free_records;
+    free_records = r->next;
+    return r;
+}
+
+/*
+ * page_round - round size up to a whole number of pages
+ */
+static size_t page_round(size_t size)
+{
+    return (size + mem_page - 1) & ~(mem_page - 1);
+}
@@ -2,7 +2,18 @@
  * memlib.c - a module that simulates the memory system.  Needed because it 
  *            allows us to interleave calls from the student's malloc package 
  *            with the system's malloc package in libc.
+ *
+ * Each heap is an arena: a mapping of its own with a brk pointer that
+ * moves through it.  mem_arena_create makes as many as are wanted, and
+ * mem_arena_destroy gives one back to the system in a single step.
+ * The original single-heap interface (mem_init, mem_sbrk, mem_heap_lo,
+ * and so on) works on a default arena of MAX_HEAP bytes.  Regions from
+ * mem_map belong to no arena.
+ *
+ * A heap can be backed by huge pages, to take TLB misses out of
+ * workloads that touch many blocks: see mem_set_pages.
  */
+#define _GNU_SOURCE            /* for mremap */
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -14,24 +25,49 @@
 #include "memlib.h"
 #include "config.h"
 
+#define HUGE_PAGE (2*(1<<20))  /* huge page size and heap alignment */
+
+/* One heap and the mapping that holds it */
+struct mem_arena {
+    char *start_brk;  /* points to first byte of heap */
+    char *brk;        /* points to last byte of heap */
+    char *max_addr;   /* largest legal heap address */
+    char *brk_hwm;    /* highest brk since the arena was made */
+    char *base;       /* start of the mapping holding the heap */
+    size_t len;       /* ... and its length */
+    int pages;        /* kind of page behind it, MEM_PAGES_xxx */
+};
+
+/* Records one region handed out by mem_map */
+typedef struct region_t {
+    char *lo;               /* first byte of the mapping */
+    size_t size;            /* length of the mapping in bytes */
+    struct region_t *next;  /* next list element */
+} region_t;
+
 /* private variables */
-static char *mem_start_brk;  /* points to first byte of heap */
-static char *mem_brk;        /* points to last byte of heap */
-static char *mem_max_addr;   /* largest legal heap address */ 
+static mem_arena_t mem_default;  /* the heap of mem_init and mem_sbrk */
+static int mem_want_pages = MEM_PAGES_BASE; /* see mem_set_pages */
+static region_t *mem_regions;  /* regions outside the heap from mem_map */
+static size_t mem_map_bytes;   /* total bytes in those regions */
+static size_t mem_threshold = MMAP_THRESHOLD; /* see mem_map_threshold */
+
+/* private helper routines */
+static int arena_map(mem_arena_t *a, size_t size);
+static void arena_release(mem_arena_t *a, void *lo, size_t len);
+static size_t resident_pages(char *lo, size_t len);
+static char *map_hugetlb(mem_arena_t *a, size_t size);
+static char *map_thp(mem_arena_t *a, size_t size);
 
 /* 
  * mem_init - initialize the memory system model
  */
 void mem_init(void)
 {
-    /* allocate the storage we will use to model the available VM */
-    if ((mem_start_brk = (char *)malloc(MAX_HEAP)) == NULL) {
-	fprintf(stderr, "mem_init_vm: malloc error\n");
+    if (arena_map(&mem_default, MAX_HEAP) < 0) {
+	fprintf(stderr, "mem_init_vm: mmap error\n");
 	exit(1);
     }
-
-    mem_max_addr = mem_start_brk + MAX_HEAP;  /* max legal heap address */
-    mem_brk = mem_start_brk;                  /* heap is empty initially */
 }
 
 /* 
@@ -39,41 +75,155 @@ void mem_init(void)
  */
 void mem_deinit(void)
 {
-    free(mem_start_brk);
+    mem_reset_brk();
+    munmap(mem_default.base, mem_default.len);
 }
 
 /*
- * mem_reset_brk - reset the simulated brk pointer to make an empty heap
+ * mem_reset_brk - reset the simulated brk pointer to make an empty heap,
+ *    and unmap every region from mem_map
  */
 void mem_reset_brk()
 {
-    mem_brk = mem_start_brk;
+    region_t *r;
+
+    mem_arena_reset(&mem_default);
+    while ((r = mem_regions) != NULL) {
+	mem_regions = r->next;
+	munmap(r->lo, r->size);
+	free(r);
+    }
+    mem_map_bytes = 0;
 }
 
 /* 
  * mem_sbrk - simple model of the sbrk function. Extends the heap 
- *    by incr bytes and returns the start address of the new area. In
- *    this model, the heap cannot be shrunk.
+ *    by incr bytes and returns the start address of the new area. A
+ *    negative incr shrinks the heap and releases the whole pages it
+ *    gave up, as with mem_release.
  */
 void *mem_sbrk(int incr) 
 {
-    char *old_brk = mem_brk;
+    return mem_arena_sbrk(&mem_default, incr);
+}
+
+/*
+ * mem_arena_create - make a new, empty heap of at most size bytes,
+ *    backed by the kind of page set with mem_set_pages. Returns NULL
+ *    if there is no memory for it.
+ */
+mem_arena_t *mem_arena_create(size_t size)
+{
+    mem_arena_t *a;
+
+    if ((a = (mem_arena_t *)malloc(sizeof(mem_arena_t))) == NULL)
+	return NULL;
+    if (arena_map(a, size) < 0) {
+	free(a);
+	return NULL;
+    }
+    return a;
+}
+
+/*
+ * mem_arena_destroy - give arena a and everything in its heap back
+ *    to the system
+ */
+void mem_arena_destroy(mem_arena_t *a)
+{
+    munmap(a->base, a->len);
+    free(a);
+}
+
+/*
+ * mem_arena_reset - empty the heap of arena a, keeping its mapping
+ */
+void mem_arena_reset(mem_arena_t *a)
+{
+    a->brk = a->start_brk;
+}
+
+/*
+ * mem_arena_sbrk - mem_sbrk for the heap of arena a
+ */
+void *mem_arena_sbrk(mem_arena_t *a, int incr)
+{
+    char *old_brk = a->brk;
 
-    if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr)) {
+    if ((a->brk + incr) > a->max_addr) {
 	errno = ENOMEM;
 	fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
 	return (void *)-1;
     }
-    mem_brk += incr;
+    if ((a->brk + incr) < a->start_brk) {
+	errno = EINVAL;
+	fprintf(stderr, 
+		"ERROR: mem_sbrk failed. Shrank below the heap start...\n");
+	return (void *)-1;
+    }
+    a->brk += incr;
+    if (incr < 0)
+	arena_release(a, a->brk, -incr);
+    if (a->brk > a->brk_hwm)
+	a->brk_hwm = a->brk;
     return (void *)old_brk;
 }
 
+/*
+ * mem_arena_lo, mem_arena_hi - return the addresses of the first and
+ *    last heap bytes of arena a
+ */
+void *mem_arena_lo(mem_arena_t *a)
+{
+    return (void *)a->start_brk;
+}
+
+void *mem_arena_hi(mem_arena_t *a)
+{
+    return (void *)(a->brk - 1);
+}
+
+/*
+ * mem_arena_heapsize - returns the heap size of arena a in bytes
+ */
+size_t mem_arena_heapsize(mem_arena_t *a)
+{
+    return (size_t)(a->brk - a->start_brk);
+}
+
+/*
+ * mem_release - tell the system that the whole pages inside [lo, lo+len)
+ *    hold nothing worth keeping. They stay mapped, but stop counting
+ *    toward the resident set and read as zeros when next touched.
+ */
+void mem_release(void *lo, size_t len)
+{
+    arena_release(&mem_default, lo, len);
+}
+
+/*
+ * mem_resident - returns the number of bytes of the heap and of the
+ *    mem_map regions that are currently resident in memory
+ */
+size_t mem_resident()
+{
+    size_t pagesize = mem_pagesize();
+    size_t npages = 0;
+    region_t *r;
+
+    npages += resident_pages(mem_default.start_brk,
+			     mem_default.brk_hwm - mem_default.start_brk);
+    for (r = mem_regions; r != NULL; r = r->next)
+	npages += resident_pages(r->lo, r->size);
+    return npages * pagesize;
+}
+
 /*
  * mem_heap_lo - return address of the first heap byte
  */
 void *mem_heap_lo()
 {
-    return (void *)mem_start_brk;
+    return mem_arena_lo(&mem_default);
 }
 
 /* 
@@ -81,7 +231,7 @@ void *mem_heap_lo()
  */
 void *mem_heap_hi()
 {
-    return (void *)(mem_brk - 1);
+    return mem_arena_hi(&mem_default);
 }
 
 /*
@@ -89,7 +239,7 @@ void *mem_heap_hi()
  */
 size_t mem_heapsize() 
 {
-    return (size_t)(mem_brk - mem_start_brk);
+    return mem_arena_heapsize(&mem_default);
 }
 
 /*
@@ -99,3 +249,266 @@ size_t mem_pagesize()
 {
     return (size_t)getpagesize();
 }
+
+/*
+ * mem_map - give the allocator a region of at least size bytes of its
+ *    own, outside the heap, for a large block. The region is page
+ *    aligned and its length is rounded up to a whole number of pages.
+ */
+void *mem_map(size_t size)
+{
+    region_t *r;
+    void *p;
+
+    size = (size + mem_pagesize() - 1) & ~(mem_pagesize() - 1);
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE, 
+	     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+	errno = ENOMEM;
+	fprintf(stderr, "ERROR: mem_map failed. Ran out of memory...\n");
+	return (void *)-1;
+    }
+
+    if ((r = (region_t *)malloc(sizeof(region_t))) == NULL) {
+	fprintf(stderr, "mem_map: malloc error\n");
+	exit(1);
+    }
+    r->lo = p;
+    r->size = size;
+    r->next = mem_regions;
+    mem_regions = r;
+    mem_map_bytes += size;
+    return p;
+}
+
+/*
+ * mem_remap - resize the region at lo to at least size bytes, possibly
+ *    moving it. Returns the new start of the region, or (void *)-1 if
+ *    it cannot be resized, in which case it is left alone.
+ */
+void *mem_remap(void *lo, size_t size)
+{
+    region_t *r;
+    void *p;
+
+    for (r = mem_regions; r != NULL && r->lo != lo; r = r->next)
+	;
+    if (r == NULL)
+	return (void *)-1;
+
+    size = (size + mem_pagesize() - 1) & ~(mem_pagesize() - 1);
+#ifdef MREMAP_MAYMOVE
+    if ((p = mremap(r->lo, r->size, size, MREMAP_MAYMOVE)) == MAP_FAILED)
+	return (void *)-1;
+#else
+    return (void *)-1;   /* no mremap here: the caller has to copy */
+#endif
+    mem_map_bytes += size - r->size;
+    r->lo = p;
+    r->size = size;
+    return p;
+}
+
+/*
+ * mem_unmap - return the region at lo, from mem_map, to the system
+ */
+void mem_unmap(void *lo)
+{
+    region_t *r, **prevpp;
+
+    for (prevpp = &mem_regions; (r = *prevpp) != NULL; prevpp = &r->next) {
+	if (r->lo == lo) {
+	    *prevpp = r->next;
+	    munmap(r->lo, r->size);
+	    mem_map_bytes -= r->size;
+	    free(r);
+	    return;
+	}
+    }
+    fprintf(stderr, "ERROR: mem_unmap of unknown region %p\n", lo);
+}
+
+/*
+ * mem_is_mapped - is [lo, hi] inside a single region from mem_map?
+ */
+int mem_is_mapped(void *lo, void *hi)
+{
+    region_t *r;
+
+    for (r = mem_regions; r != NULL; r = r->next)
+	if ((char *)lo >= r->lo && (char *)hi < r->lo + r->size)
+	    return 1;
+    return 0;
+}
+
+/*
+ * mem_mapsize - returns the total bytes in regions from mem_map
+ */
+size_t mem_mapsize()
+{
+    return mem_map_bytes;
+}
+
+/*
+ * mem_map_threshold - requests of at least this many bytes should be
+ *    given a region of their own with mem_map instead of heap space
+ */
+size_t mem_map_threshold()
+{
+    return mem_threshold;
+}
+
+/*
+ * mem_set_map_threshold - change the value returned by
+ *    mem_map_threshold; takes effect at the allocator's next init
+ */
+void mem_set_map_threshold(size_t size)
+{
+    mem_threshold = size;
+}
+
+/*
+ * mem_set_pages - back heaps with the given kind of page, one of the
+ *    MEM_PAGES_xxx constants, from the next mem_init or
+ *    mem_arena_create on. Huge pages that cannot be had fall back to
+ *    THP, and THP to base pages.
+ */
+void mem_set_pages(int kind)
+{
+    mem_want_pages = kind;
+}
+
+/*
+ * mem_pages - returns the kind of page mem_init managed to get
+ */
+int mem_pages()
+{
+    return mem_default.pages;
+}
+
+/*
+ * The remaining routines are internal helper routines
+ */
+
+/*
+ * arena_map - map an empty heap of size bytes for arena a, so that
+ *    pages handed back with mem_release really leave the process.
+ *    Returns -1 if it cannot be mapped.
+ */
+static int arena_map(mem_arena_t *a, size_t size)
+{
+    char *p = NULL;
+
+    a->pages = MEM_PAGES_BASE;
+    if (mem_want_pages == MEM_PAGES_HUGETLB)
+	p = map_hugetlb(a, size);
+    if (p == NULL && mem_want_pages != MEM_PAGES_BASE)
+	p = map_thp(a, size);
+    if (p == NULL) {
+	p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+	    return -1;
+	a->base = p;
+	a->len = size;
+    }
+
+    a->start_brk = p;
+    a->max_addr = p + size;  /* max legal heap address */
+    a->brk = p;              /* heap is empty initially */
+    a->brk_hwm = p;
+    return 0;
+}
+
+/*
+ * arena_release - mem_release within the heap of arena a, whose huge
+ *    pages, if it has them from the pool, can only go back whole
+ */
+static void arena_release(mem_arena_t *a, void *lo, size_t len)
+{
+    size_t pagesize = (a->pages == MEM_PAGES_HUGETLB) ? 
+	HUGE_PAGE : mem_pagesize();
+    char *start = (char *)(((size_t)lo + pagesize - 1) & ~(pagesize - 1));
+    char *end = (char *)(((size_t)lo + len) & ~(pagesize - 1));
+
+    if (start < end)
+	madvise(start, end - start, MADV_DONTNEED);
+}
+
+/*
+ * map_hugetlb - map a heap of size bytes for arena a from the pool of
+ *    reserved huge pages, or return NULL if the pool is too small or
+ *    the system has none
+ */
+static char *map_hugetlb(mem_arena_t *a, size_t size)
+{
+#ifdef MAP_HUGETLB
+    size_t len = (size + HUGE_PAGE - 1) & ~(size_t)(HUGE_PAGE - 1);
+    char *p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+    if (p == MAP_FAILED)
+	return NULL;
+    a->base = p;
+    a->len = len;
+    a->pages = MEM_PAGES_HUGETLB;
+    return p;
+#else
+    return NULL;
+#endif
+}
+
+/*
+ * map_thp - map a heap of size bytes for arena a at a huge page
+ *    boundary and ask for transparent huge pages there, or return
+ *    NULL if the kernel will not give them
+ */
+static char *map_thp(mem_arena_t *a, size_t size)
+{
+#ifdef MADV_HUGEPAGE
+    size_t len = size + HUGE_PAGE;
+    char *p, *lo;
+
+    p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+	     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+	return NULL;
+    lo = (char *)(((size_t)p + HUGE_PAGE - 1) & ~(size_t)(HUGE_PAGE - 1));
+    if (madvise(lo, size, MADV_HUGEPAGE) < 0) {
+	munmap(p, len);
+	return NULL;
+    }
+    a->base = p;
+    a->len = len;
+    a->pages = MEM_PAGES_THP;
+    return lo;
+#else
+    return NULL;
+#endif
+}
+
+/*
+ * resident_pages - count the resident pages in page-aligned [lo, lo+len)
+ */
+static size_t resident_pages(char *lo, size_t len)
+{
+    static unsigned char *vec = NULL;
+    static size_t veclen = 0;
+    size_t i, n, npages = (len + mem_pagesize() - 1) / mem_pagesize();
+
+    if (npages == 0)
+	return 0;
+    if (npages > veclen) {
+	free(vec);
+	if ((vec = (unsigned char *)malloc(npages)) == NULL) {
+	    fprintf(stderr, "mem_resident: malloc error\n");
+	    exit(1);
+	}
+	veclen = npages;
+    }
+    if (mincore(lo, len, vec) < 0)
+	return 0;
+    for (i = n = 0; i < npages; i++)
+	n += vec[i] & 1;
+    return n;
+}
@@ -8,4 +8,35 @@ void *mem_heap_lo(void);
 void *mem_heap_hi(void);
 size_t mem_heapsize(void);
 size_t mem_pagesize(void);
+void mem_release(void *lo, size_t len);
+size_t mem_resident(void);
 
+void *mem_map(size_t size);
+void *mem_remap(void *lo, size_t size);
+void mem_unmap(void *lo);
+int mem_is_mapped(void *lo, void *hi);
+size_t mem_mapsize(void);
+size_t mem_map_threshold(void);
+void mem_set_map_threshold(size_t size);
+
+/* Kinds of page that can back the heap, for mem_set_pages/mem_pages */
+#define MEM_PAGES_BASE    0   /* the system's ordinary pages */
+#define MEM_PAGES_THP     1   /* transparent huge pages (MADV_HUGEPAGE) */
+#define MEM_PAGES_HUGETLB 2   /* MAP_HUGETLB pages from the reserved pool */
+
+void mem_set_pages(int kind);
+int mem_pages(void);
+
+/* 
+ * Arenas: heaps of their own, each with its own brk. The functions
+ * above work on a default arena made by mem_init.
+ */
+typedef struct mem_arena mem_arena_t;
+
+mem_arena_t *mem_arena_create(size_t size);
+void mem_arena_destroy(mem_arena_t *a);
+void mem_arena_reset(mem_arena_t *a);
+void *mem_arena_sbrk(mem_arena_t *a, int incr);
+void *mem_arena_lo(mem_arena_t *a);
+void *mem_arena_hi(mem_arena_t *a);
+size_t mem_arena_heapsize(mem_arena_t *a);
@@ -0,0 +1,503 @@
+/*
+ * mm-buddy.c - Binary buddy malloc package.
+ *
+ * Every block is 2^k bytes for some order k in [MIN_ORDER, MAX_ORDER]
+ * and starts at an offset from the heap base that is a multiple of its
+ * size, so the buddy of the block at offset off is at off ^ 2^k.  The
+ * first word of every block is a header holding its order and an
+ * allocated bit; the payload follows it:
+ *
+ *     allocated:  | hdr | payload ............................ |
+ *     free:       | hdr | pred | succ | (unused) ............. |
+ *
+ * Free blocks sit on one doubly linked list per order.  mm_malloc takes
+ * the smallest free block of sufficient order and splits it in half
+ * until it has the right order, putting the upper halves on their
+ * lists.  mm_free merges a block with its buddy for as long as the
+ * buddy is free and whole, so coalescing costs at most one step per
+ * order.
+ *
+ * A payload always sits one word past the start of its block, so it
+ * can never be aligned to more than a word.  mm_memalign therefore
+ * takes a block with room for the request plus the alignment and
+ * returns an aligned address inside it, with an INNER header just
+ * below that address giving its distance from the block.  Unlike
+ * mm.c it cannot give the padding back to the free lists, since the
+ * blocks around it must keep their power-of-two sizes, but it does
+ * free the upper halves that the request does not reach.
+ *
+ * The heap grows on demand rather than in one power-of-two arena.  To
+ * add a block of order k the heap end must be 2^k aligned, so the
+ * smaller blocks that bring it there are added to the free lists first.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "mm.h"
+#include "memlib.h"
+
+#define WSIZE      (sizeof(size_t))  /* header/link word size */
+#define MIN_ORDER  5                 /* hdr + pred + succ, rounded up */
+#define MAX_ORDER  30
+#define NUM_ORDERS (MAX_ORDER + 1)
+
+/* Pack an order and allocated bit into a header */
+#define PACK(order, alloc)  (((size_t)(order) << 2) | (alloc))
+
+/* Read and write the header of the block at address blk */
+#define GET(blk)        (*(size_t *)(blk))
+#define PUT(blk, val)   (*(size_t *)(blk) = (val))
+#define GET_ORDER(blk)  ((int)(GET(blk) >> 2))
+#define GET_ALLOC(blk)  (GET(blk) & 0x1)
+
+/* Header bit of an aligned payload inside a block, whose header holds
+   the distance back to the block in place of the order */
+#define INNER           0x2
+#define IS_INNER(bp)    (GET(BLOCK(bp)) & INNER)
+
+/* Convert between block and payload pointers */
+#define PAYLOAD(blk)  ((char *)(blk) + WSIZE)
+#define BLOCK(bp)     ((char *)(bp) - WSIZE)
+
+/* Offset of a block from the heap base, and the block at an offset */
+#define OFFSET(blk)   ((size_t)((char *)(blk) - heap_base))
+#define AT(off)       (heap_base + (off))
+#define BUDDY(blk, k) AT(OFFSET(blk) ^ ((size_t)1 << (k)))
+
+/* The free-list links of free block blk */
+#define PRED(blk)  (*(char **)((char *)(blk) + WSIZE))
+#define SUCC(blk)  (*(char **)((char *)(blk) + 2*WSIZE))
+
+/* Global variables */
+static char *heap_base;                  /* offset 0 of every block */
+static size_t heap_end;                  /* offset of the heap end */
+static char *free_lists[NUM_ORDERS];
+static mm_realloc_stats_t realloc_stats; /* mm_realloc path counters */
+
+/* Internal helper routines */
+static char *block_of(void *ptr);
+static int order_of(size_t size);
+static char *grow_heap(int k);
+static char *take_block(int k);
+static void free_block(char *blk, int k);
+static void split(char *blk, int k, int want);
+static void insert_block(char *blk, int k);
+static void remove_block(char *blk, int k);
+
+/*
+ * mm_init - initialize the malloc package.
+ */
+int mm_init(void)
+{
+    int k;
+
+    for (k = 0; k < NUM_ORDERS; k++)
+        free_lists[k] = NULL;
+    memset(&realloc_stats, 0, sizeof(realloc_stats));
+
+    if ((heap_base = mem_sbrk(0)) == (void *)-1)
+        return -1;
+    heap_end = 0;
+    return 0;
+}
+
+/*
+ * mm_malloc - Allocate a block of the smallest order that holds size
+ *     payload bytes
+ */
+void *mm_malloc(size_t size)
+{
+    char *blk;
+    int k;
+
+    if (size == 0)
+        return NULL;
+    if ((k = order_of(size)) < 0)
+        return NULL;
+    if ((blk = take_block(k)) == NULL)
+        return NULL;
+    PUT(blk, PACK(k, 1));
+    return PAYLOAD(blk);
+}
+
+/*
+ * mm_free - Free a block, merging it with its buddies
+ */
+void mm_free(void *ptr)
+{
+    char *blk;
+
+    if (ptr == NULL)
+        return;
+    blk = block_of(ptr);
+    free_block(blk, GET_ORDER(blk));
+}
+
+/*
+ * mm_realloc - Resize a block in place whenever possible: shrink by
+ *     freeing upper halves, grow by absorbing free upper buddies, or
+ *     grow by extending the heap when the block ends it.  Only when
+ *     none of these apply is the payload copied to a new block.
+ */
+void *mm_realloc(void *ptr, size_t size)
+{
+    char *blk, *newptr;
+    size_t copySize, off;
+    int k, want, j;
+
+    if (ptr == NULL)
+        return mm_malloc(size);
+    if (size == 0) {
+        mm_free(ptr);
+        return NULL;
+    }
+    if ((want = order_of(size)) < 0)
+        return NULL;
+
+    /* Aligned payloads stay put while they are big enough */
+    if (IS_INNER(ptr)) {
+        copySize = mm_usable_size(ptr);
+        if (size <= copySize) {
+            blk = block_of(ptr);
+            if (order_of((char *)ptr - blk + size - WSIZE) < GET_ORDER(blk))
+                realloc_stats.shrink++;
+            else
+                realloc_stats.fit++;
+            return ptr;
+        }
+        goto copy;
+    }
+
+    blk = BLOCK(ptr);
+    k = GET_ORDER(blk);
+    off = OFFSET(blk);
+
+    /* Shrink (or keep) in place, freeing the upper halves */
+    if (want <= k) {
+        if (want < k)
+            realloc_stats.shrink++;
+        else
+            realloc_stats.fit++;
+        split(blk, k, want);
+        PUT(blk, PACK(want, 1));
+        return ptr;
+    }
+
+    /*
+     * Growing in place needs every upper buddy from order k up to want
+     * to be either a whole free block or beyond the heap end.
+     */
+    for (j = k; j < want; j++) {
+        if (off & ((size_t)1 << j))
+            break;                          /* we are an upper buddy */
+        if (off + ((size_t)1 << j) >= heap_end)
+            continue;                       /* buddy not yet in the heap */
+        if (GET_ALLOC(AT(off + ((size_t)1 << j))) ||
+            GET_ORDER(AT(off + ((size_t)1 << j))) != j)
+            break;
+    }
+    if (j == want) {
+        if (off + ((size_t)1 << want) > heap_end) {
+            if (mem_sbrk(off + ((size_t)1 << want) - heap_end) == (void *)-1)
+                return NULL;
+            realloc_stats.extend++;
+        }
+        else
+            realloc_stats.grow++;
+        for (j = k; j < want; j++)
+            if (off + ((size_t)1 << j) < heap_end)
+                remove_block(AT(off + ((size_t)1 << j)), j);
+        if (off + ((size_t)1 << want) > heap_end)
+            heap_end = off + ((size_t)1 << want);
+        PUT(blk, PACK(want, 1));
+        return ptr;
+    }
+
+    /* Fall back on copying to a new block */
+    copySize = ((size_t)1 << k) - WSIZE;
+ copy:
+    if ((newptr = mm_malloc(size)) == NULL)
+        return NULL;
+    realloc_stats.copy++;
+    if (size < copySize)
+        copySize = size;
+    memcpy(newptr, ptr, copySize);
+    mm_free(ptr);
+    return newptr;
+}
+
+/*
+ * mm_memalign - Allocate a block with room for size bytes at a multiple
+ *     of alignment, a power of two, and return that address
+ */
+void *mm_memalign(size_t alignment, size_t size)
+{
+    char *blk, *ptr;
+    int k, want;
+
+    if (alignment <= WSIZE)
+        return mm_malloc(size);
+    if (size == 0 || (alignment & (alignment - 1)))
+        return NULL;
+    if (alignment > ((size_t)1 << MAX_ORDER) ||
+        (k = order_of(size + alignment - WSIZE)) < 0)
+        return NULL;
+    if ((blk = take_block(k)) == NULL)
+        return NULL;
+
+    /* Keep only the lower halves that the payload reaches */
+    ptr = (char *)(((size_t)PAYLOAD(blk) + alignment - 1) & ~(alignment - 1));
+    want = order_of(ptr - blk + size - WSIZE);
+    split(blk, k, want);
+    PUT(blk, PACK(want, 1));
+    if (ptr != PAYLOAD(blk))
+        PUT(BLOCK(ptr), ((size_t)(ptr - blk) << 2) | INNER | 1);
+    return ptr;
+}
+
+/*
+ * mm_usable_size - Return the number of payload bytes in block ptr
+ */
+size_t mm_usable_size(void *ptr)
+{
+    char *blk = block_of(ptr);
+
+    return ((size_t)1 << GET_ORDER(blk)) - ((char *)ptr - blk);
+}
+
+/*
+ * mm_get_realloc_stats - Report how often each mm_realloc path ran
+ *     since the last mm_init.
+ */
+void mm_get_realloc_stats(mm_realloc_stats_t *stats)
+{
+    *stats = realloc_stats;
+}
+
+/*
+ * mm_heapinfo - Walk the heap and the free lists and describe them
+ */
+void mm_heapinfo(mm_heapinfo_t *info)
+{
+    char *blk;
+    size_t off, size;
+    int k;
+
+    memset(info, 0, sizeof(*info));
+    info->heap_bytes = mem_heapsize();
+    for (off = 0; off < heap_end; off += size) {
+        blk = AT(off);
+        k = GET_ORDER(blk);
+        size = (size_t)1 << k;
+        if (GET_ALLOC(blk)) {
+            info->alloc_blocks++;
+            info->alloc_bytes += size;
+            continue;
+        }
+        info->free_blocks++;
+        info->free_bytes += size;
+        if (size > info->largest_free)
+            info->largest_free = size;
+        info->free_hist[k < MM_INFO_BINS ? k : MM_INFO_BINS - 1]++;
+    }
+
+    info->nclasses = NUM_ORDERS < MM_INFO_CLASSES ? NUM_ORDERS : MM_INFO_CLASSES;
+    for (k = 0; k < info->nclasses; k++)
+        for (blk = free_lists[k]; blk != NULL; blk = SUCC(blk))
+            info->class_len[k]++;
+}
+
+/*
+ * mm_checkheap - Check the heap and free lists for consistency.
+ *     Returns the number of problems found; prints every block when
+ *     verbose is set.
+ */
+int mm_checkheap(int verbose)
+{
+    char *blk;
+    size_t off, nfree = 0, nlisted = 0;
+    int k, errs = 0;
+
+    for (off = 0; off < heap_end; off += (size_t)1 << k) {
+        blk = AT(off);
+        k = GET_ORDER(blk);
+        if (verbose)
+            printf("%p: order %d %s\n", blk, k,
+                   GET_ALLOC(blk) ? "allocated" : "free");
+        if (k < MIN_ORDER || k > MAX_ORDER) {
+            printf("mm_checkheap: %p has bad order %d\n", blk, k);
+            return errs + 1;
+        }
+        if (off & (((size_t)1 << k) - 1)) {
+            printf("mm_checkheap: %p is not aligned to its size\n", blk);
+            errs++;
+        }
+        if (!GET_ALLOC(blk)) {
+            nfree++;
+            if ((off ^ ((size_t)1 << k)) < heap_end &&
+                !GET_ALLOC(BUDDY(blk, k)) && GET_ORDER(BUDDY(blk, k)) == k) {
+                printf("mm_checkheap: %p escaped coalescing\n", blk);
+                errs++;
+            }
+        }
+    }
+    if (off != heap_end) {
+        printf("mm_checkheap: last block overruns the heap end\n");
+        errs++;
+    }
+
+    for (k = 0; k < NUM_ORDERS; k++) {
+        for (blk = free_lists[k]; blk != NULL; blk = SUCC(blk)) {
+            nlisted++;
+            if (GET_ALLOC(blk) || GET_ORDER(blk) != k) {
+                printf("mm_checkheap: %p is on the wrong free list\n", blk);
+                errs++;
+            }
+            if (SUCC(blk) != NULL && PRED(SUCC(blk)) != blk) {
+                printf("mm_checkheap: %p has a broken succ link\n", blk);
+                errs++;
+            }
+        }
+    }
+    if (nfree != nlisted) {
+        printf("mm_checkheap: %zu free blocks but %zu listed\n",
+               nfree, nlisted);
+        errs++;
+    }
+    return errs;
+}
+
+/*
+ * The remaining routines are internal helper routines
+ */
+
+/*
+ * block_of - Return the block holding payload ptr, which is either just
+ *     after the block header or an aligned address behind an INNER one
+ */
+static char *block_of(void *ptr)
+{
+    if (IS_INNER(ptr))
+        return (char *)ptr - (GET(BLOCK(ptr)) >> 2);
+    return BLOCK(ptr);
+}
+
+/*
+ * order_of - Return the smallest order whose blocks hold size payload
+ *     bytes, or -1 if the request is too large
+ */
+static int order_of(size_t size)
+{
+    int k;
+
+    if (size > ((size_t)1 << MAX_ORDER) - WSIZE)
+        return -1;
+    k = 8*sizeof(long) - __builtin_clzl(size + WSIZE - 1);
+    return (k < MIN_ORDER) ? MIN_ORDER : k;
+}
+
+/*
+ * take_block - Remove a free block of order k from the free lists,
+ *     splitting a larger one or growing the heap if necessary
+ */
+static char *take_block(int k)
+{
+    char *blk;
+    int j;
+
+    for (j = k; j < NUM_ORDERS && free_lists[j] == NULL; j++)
+        ;
+    if (j == NUM_ORDERS)
+        return grow_heap(k);
+
+    blk = free_lists[j];
+    remove_block(blk, j);
+    split(blk, j, k);
+    return blk;
+}
+
+/*
+ * grow_heap - Add a block of order k at the end of the heap, first
+ *     adding the free blocks that align the heap end to 2^k
+ */
+static char *grow_heap(int k)
+{
+    size_t size = (size_t)1 << k;
+    size_t pad = -heap_end & (size - 1);
+    char *blk;
+    int j;
+
+    if (mem_sbrk(pad + size) == (void *)-1)
+        return NULL;
+    while (heap_end & (size - 1)) {
+        j = __builtin_ctzl(heap_end);
+        blk = AT(heap_end);
+        heap_end += (size_t)1 << j;
+        free_block(blk, j);
+    }
+    blk = AT(heap_end);
+    heap_end += size;
+    return blk;
+}
+
+/*
+ * free_block - Put block blk of order k on the free lists, merging it
+ *     with its buddy for as long as the buddy is free and whole
+ */
+static void free_block(char *blk, int k)
+{
+    char *buddy;
+
+    while (k < MAX_ORDER && (OFFSET(blk) ^ ((size_t)1 << k)) < heap_end) {
+        buddy = BUDDY(blk, k);
+        if (GET_ALLOC(buddy) || GET_ORDER(buddy) != k)
+            break;
+        remove_block(buddy, k);
+        if (buddy < blk)
+            blk = buddy;
+        k++;
+    }
+    insert_block(blk, k);
+}
+
+/*
+ * split - Cut block blk of order k down to order want, putting the
+ *     upper halves on the free lists
+ */
+static void split(char *blk, int k, int want)
+{
+    while (k > want) {
+        k--;
+        insert_block(blk + ((size_t)1 << k), k);
+    }
+}
+
+/*
+ * insert_block - Mark blk as a free block of order k and push it onto
+ *     the head of its free list
+ */
+static void insert_block(char *blk, int k)
+{
+    PUT(blk, PACK(k, 0));
+    PRED(blk) = NULL;
+    SUCC(blk) = free_lists[k];
+    if (free_lists[k] != NULL)
+        PRED(free_lists[k]) = blk;
+    free_lists[k] = blk;
+}
+
+/*
+ * remove_block - Unlink free block blk from the list of order k
+ */
+static void remove_block(char *blk, int k)
+{
+    if (PRED(blk) != NULL)
+        SUCC(PRED(blk)) = SUCC(blk);
+    else
+        free_lists[k] = SUCC(blk);
+    if (SUCC(blk) != NULL)
+        PRED(SUCC(blk)) = PRED(blk);
+}
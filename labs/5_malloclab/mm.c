@@ -1,5 +1,72 @@
 /*
- * mm-naive.c - The fastest, least memory-efficient malloc package.
+ * mm.c - Segregated-fit malloc package with boundary tags.
+ *
+ * Every block carries a one-word header holding the block size (a
+ * multiple of ALIGNMENT) with the allocated bit in the low order bit
+ * and, next to it, a PREV_ALLOC bit telling whether the block before
+ * it is allocated.  Only free blocks also have a footer, holding their
+ * size, since coalescing only ever needs the footer of a free
+ * neighbour; an allocated block's payload runs to its very end:
+ *
+ *     allocated:  | hdr | payload ................................ |
+ *     free:       | hdr | pred | succ | (unused) ........... | ftr |
+ *
+ * Words are 4 bytes when MM_COMPACT is set (see config.h), which it is
+ * whenever the heap cannot reach 4 GB, and 8 bytes otherwise.  With
+ * 4-byte words the free-list links are offsets from the heap base, a
+ * block costs 4 bytes on top of its payload, and the smallest block is
+ * 16 bytes.  A pad word at the heap base keeps payloads 8-byte aligned.
+ *
+ * Free blocks are kept on NUM_CLASSES explicit doubly linked lists
+ * indexed in two levels, as in TLSF: each of FL_COUNT power-of-two
+ * classes [MIN_BLOCK << f, MIN_BLOCK << (f+1)) is split into SL_COUNT
+ * lists of equal width, and the very last list also holds everything
+ * larger.  The pred/succ pointers live in the first two payload words
+ * of a free block.  Lists are LIFO.  A bitmap of the non-empty classes
+ * and one of the non-empty lists within each class lead to the first
+ * non-empty list at or above any index with two find-first-set steps.
+ *
+ * mm_malloc does a best-fit search over the first FIT_SCAN blocks of
+ * the request's own list and otherwise takes the first block of the
+ * next non-empty list up, found through the bitmaps, splitting off any
+ * remainder of at least MIN_BLOCK bytes.  Every block on a higher list
+ * is big enough, and at most 1/SL_COUNT larger than the request's list.
+ * If nothing fits, the heap is extended by the smallest amount that
+ * will do, reusing a free block at its end.
+ *
+ * mm_free coalesces immediately with both neighbours using the boundary
+ * tags, so the block before a free block is always allocated.  An
+ * allocated prologue block and a zero-size epilogue header bracket the
+ * heap so the coalescing code needs no edge cases.
+ *
+ * Requests of up to SLAB_MAX bytes are served by the slab allocator in
+ * slab.c instead, which takes its own pages with mem_sbrk.  When slab
+ * pages have been taken since the heap was last extended, extend_heap
+ * covers them with an allocated "gap" block whose header is the old
+ * epilogue, so the block structure stays walkable and never coalesces
+ * across them.  Gap blocks have the GAP bit set so that mm_heapinfo can
+ * leave them out.
+ *
+ * mm_memalign finds or makes a free block with room for the request
+ * at an aligned address past a leading fragment of at least MIN_BLOCK
+ * bytes, then frees that fragment and splits off the tail as usual,
+ * so the alignment padding goes back on the free lists.  Aligned
+ * blocks always come from the heap, never from slabs or mem_map, and
+ * are ordinary blocks once placed.
+ *
+ * Requests of at least mem_map_threshold() bytes get a mem_map region
+ * of their own, outside the heap, and mm_free unmaps it.  Such a block
+ * is told apart by its address, and has only a MAP_HDR-byte header at
+ * the start of the region holding the region's length.
+ *
+ * The heap also gives memory back.  When mm_free leaves a free block of
+ * at least TRIM_THRESHOLD bytes at the top of the heap, the heap shrinks
+ * by that block with a negative mem_sbrk.  A free block of at least
+ * RELEASE_THRESHOLD bytes elsewhere keeps its address range, but the
+ * whole pages between its links and its footer are handed back to the
+ * system with mem_release.  Only the part that the freed block and any
+ * smaller free neighbours add to it is released, since a free
+ * neighbour that was already that big has been released before.
  */
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,6 +76,8 @@
 
 #include "mm.h"
 #include "memlib.h"
+#include "slab.h"
+#include "config.h"
 
 /* single word (4) or double word (8) alignment */
 #define ALIGNMENT 8
@@ -16,56 +85,814 @@
 /* rounds up to the nearest multiple of ALIGNMENT */
 #define ALIGN(size) (((size) + (ALIGNMENT-1)) & ~0x7)
 
+/* A header, footer, or free-list link */
+#if MM_COMPACT
+typedef unsigned int word_t;
+#else
+typedef size_t word_t;
+#endif
 
-#define SIZE_T_SIZE (ALIGN(sizeof(size_t)))
+/* Basic constants */
+#define WSIZE       (sizeof(word_t))    /* header/footer/link word size */
+#define DSIZE       (2*WSIZE)           /* double word size */
+#define MIN_BLOCK   (2*DSIZE)           /* hdr + pred + succ + ftr */
+#define PAD         (ALIGNMENT - WSIZE) /* heap base pad to align payloads */
+#define MAP_HDR     ALIGNMENT           /* header of a mapped block */
+#define CHUNKSIZE   (1<<12)             /* default heap extension */
+#define SL_SHIFT    3                   /* log2 of lists per class */
+#define SL_COUNT    (1 << SL_SHIFT)     /* lists per power-of-two class */
+#define FL_COUNT    27                  /* power-of-two classes */
+#define NUM_CLASSES (FL_COUNT * SL_COUNT) /* number of segregated lists */
+#define FIT_SCAN    16                  /* max blocks examined per class */
+#define TRIM_THRESHOLD    (1<<20)       /* free top block to give back */
+#define RELEASE_THRESHOLD (1<<20)       /* free block to release pages of */
 
-/* 
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+
+/* Pack a size and allocated bits into a word */
+#define PACK(size, alloc)  ((size) | (alloc))
+
+/* Read and write a word at address p */
+#define GET(p)       (*(word_t *)(p))
+#define PUT(p, val)  (*(word_t *)(p) = (val))
+
+/* Read the size and allocated fields from address p */
+#define GET_SIZE(p)  (GET(p) & ~(word_t)0x7)
+#define GET_ALLOC(p) (GET(p) & 0x1)
+
+/* Header bit set when the previous block is allocated */
+#define PREV_ALLOC        0x2
+#define GET_PREV_ALLOC(p) (GET(p) & PREV_ALLOC)
+
+/* Header bit of a gap block covering slab pages */
+#define GAP          0x4
+#define IS_GAP(p)    (GET(p) & GAP)
+
+/* Is block ptr bp in a mem_map region of its own rather than the heap? */
+#define IS_MAPPED(bp) \
+    ((char *)(bp) < heap_lo || (char *)(bp) > (char *)mem_heap_hi())
+
+/* The length of mapped block bp's region, kept in its header */
+#define MAP_LEN(bp)  (*(size_t *)((char *)(bp) - MAP_HDR))
+
+/* Given block ptr bp, compute address of its header and footer */
+#define HDRP(bp)     ((char *)(bp) - WSIZE)
+#define FTRP(bp)     ((char *)(bp) + GET_SIZE(HDRP(bp)) - DSIZE)
+
+/* Given block ptr bp, compute address of next and previous blocks;
+   the previous block must be free, so that it has a footer */
+#define NEXT_BLKP(bp)  ((char *)(bp) + GET_SIZE((char *)(bp) - WSIZE))
+#define PREV_BLKP(bp)  ((char *)(bp) - GET_SIZE((char *)(bp) - DSIZE))
+
+/* Given free block ptr bp, read and write the free-list links stored
+   in its payload: pointers, or offsets from the heap base if compact */
+#if MM_COMPACT
+#define TO_LINK(p)    ((p) ? (word_t)((char *)(p) - heap_lo) : 0)
+#define FROM_LINK(w)  ((w) ? heap_lo + (w) : NULL)
+#else
+#define TO_LINK(p)    ((word_t)(p))
+#define FROM_LINK(w)  ((char *)(w))
+#endif
+#define PRED(bp)        FROM_LINK(((word_t *)(bp))[0])
+#define SUCC(bp)        FROM_LINK(((word_t *)(bp))[1])
+#define SET_PRED(bp, p) (((word_t *)(bp))[0] = TO_LINK(p))
+#define SET_SUCC(bp, p) (((word_t *)(bp))[1] = TO_LINK(p))
+
+/* Global variables */
+static char *heap_lo;                  /* heap base */
+static char *heap_listp;               /* prologue block */
+static char *epilogue;                 /* epilogue header */
+static size_t map_threshold;           /* mem_map requests this big */
+static size_t nmapped;                 /* blocks in mem_map regions */
+static char *seg_lists[NUM_CLASSES];   /* heads of the free lists */
+static unsigned int fl_map;            /* bit f: class f has a free block */
+static unsigned int sl_map[FL_COUNT];  /* bit s: list s of class f does */
+static mm_realloc_stats_t realloc_stats; /* mm_realloc path counters */
+
+/* Function prototypes for internal helper routines */
+static void *extend_heap(size_t size);
+static void *coalesce(void *bp);
+static void *find_fit(size_t asize);
+static void place(void *bp, size_t asize);
+static void split_tail(void *bp, size_t asize);
+static void set_prev_alloc(void *bp, int alloc);
+static int size_class(size_t size);
+static int next_class(int c);
+static void insert_block(void *bp);
+static void remove_block(void *bp);
+static size_t adjust_size(size_t size);
+static void *map_block(size_t size);
+static void *remap_block(void *bp, size_t size);
+static int trim_heap(void *bp);
+static void release_block(void *bp, char *lo, char *hi);
+
+/*
  * mm_init - initialize the malloc package.
  */
 int mm_init(void)
 {
+    int i;
+
+    for (i = 0; i < NUM_CLASSES; i++)
+        seg_lists[i] = NULL;
+    fl_map = 0;
+    memset(sl_map, 0, sizeof(sl_map));
+    memset(&realloc_stats, 0, sizeof(realloc_stats));
+    nmapped = 0;
+
+    /* Create the initial empty heap: pad + prologue + epilogue hdr */
+    if ((heap_lo = mem_sbrk(2*ALIGNMENT)) == (void *)-1)
+        return -1;
+    heap_listp = heap_lo + PAD + WSIZE;
+    PUT(HDRP(heap_listp), PACK(ALIGNMENT, PREV_ALLOC | 1));
+    epilogue = HDRP(NEXT_BLKP(heap_listp));
+    PUT(epilogue, PACK(0, PREV_ALLOC | 1));
+    map_threshold = mem_map_threshold();
+    slab_init();
     return 0;
 }
 
-/* 
- * mm_malloc - Allocate a block by incrementing the brk pointer.
- *     Always allocate a block whose size is a multiple of the alignment.
+/*
+ * mm_malloc - Allocate a block from the segregated free lists,
+ *     extending the heap only when no free block fits.
  */
 void *mm_malloc(size_t size)
 {
-    int newsize = ALIGN(size + SIZE_T_SIZE);
-    void *p = mem_sbrk(newsize);
-    if ((long)p == -1)
-	return NULL;
-    else {
-        *(size_t *)p = size;
-        return (void *)((char *)p + SIZE_T_SIZE);
+    size_t asize;
+    char *bp;
+
+    if (size == 0)
+        return NULL;
+    if (size <= SLAB_MAX)
+        return slab_alloc(size);
+    if (size >= map_threshold)
+        return map_block(size);
+    if (size > MAX_HEAP)
+        return NULL;    /* would not fit, nor maybe in a header word */
+
+    asize = adjust_size(size);
+    if ((bp = find_fit(asize)) == NULL) {
+        if ((bp = extend_heap(asize)) == NULL)
+            return NULL;
     }
+    place(bp, asize);
+    return bp;
 }
 
 /*
- * mm_free - Freeing a block does nothing.
+ * mm_free - Free a block and coalesce it with any free neighbours.
  */
 void mm_free(void *ptr)
 {
+    size_t size, nsize;
+    char *lo, *hi;
+
+    if (ptr == NULL)
+        return;
+    if (slab_owns(ptr)) {
+        slab_free(ptr);
+        return;
+    }
+    if (IS_MAPPED(ptr)) {
+        mem_unmap((char *)ptr - MAP_HDR);
+        nmapped--;
+        return;
+    }
+
+    /* The bytes this free adds to a block that may get released */
+    size = GET_SIZE(HDRP(ptr));
+    lo = HDRP(ptr);
+    hi = lo + size;
+    if (!GET_PREV_ALLOC(HDRP(ptr)) &&
+        GET_SIZE(HDRP(ptr) - WSIZE) < RELEASE_THRESHOLD)
+        lo -= GET_SIZE(HDRP(ptr) - WSIZE);
+    nsize = GET_SIZE(HDRP(NEXT_BLKP(ptr)));
+    if (!GET_ALLOC(HDRP(NEXT_BLKP(ptr))) && nsize < RELEASE_THRESHOLD)
+        hi += nsize;
+
+    PUT(HDRP(ptr), PACK(size, GET_PREV_ALLOC(HDRP(ptr))));
+    PUT(FTRP(ptr), PACK(size, 0));
+    ptr = coalesce(ptr);
+    if (!trim_heap(ptr)) {
+        insert_block(ptr);
+        release_block(ptr, lo, hi);
+    }
 }
 
 /*
- * mm_realloc - Implemented simply in terms of mm_malloc and mm_free
+ * mm_realloc - Resize a block in place whenever possible: shrink by
+ *     splitting off the tail, grow into a free next block, or grow by
+ *     extending the heap when the block is the last one.  Only when none
+ *     of these apply is the payload copied to a new block.
  */
 void *mm_realloc(void *ptr, size_t size)
 {
     void *oldptr = ptr;
     void *newptr;
-    size_t copySize;
-    
+    size_t copySize, asize, csize, nsize, prev;
+    char *next;
+
+    if (ptr == NULL)
+        return mm_malloc(size);
+    if (size == 0) {
+        mm_free(ptr);
+        return NULL;
+    }
+
+    /* Slab objects can only stay put if they are big enough */
+    if (slab_owns(ptr)) {
+        if (size <= slab_usable_size(ptr)) {
+            if (slab_class_size(size) < slab_usable_size(ptr))
+                realloc_stats.shrink++;
+            else
+                realloc_stats.fit++;
+            return ptr;
+        }
+        copySize = slab_usable_size(ptr);
+        goto copy;
+    }
+
+    /* Mapped blocks stay mapped while they are big enough */
+    if (IS_MAPPED(ptr)) {
+        if (size <= mm_usable_size(ptr) && size >= map_threshold) {
+            if (size + mem_pagesize() <= mm_usable_size(ptr))
+                realloc_stats.shrink++;
+            else
+                realloc_stats.fit++;
+            return ptr;
+        }
+        if (size >= map_threshold && (newptr = remap_block(ptr, size))) {
+            realloc_stats.extend++;
+            return newptr;
+        }
+        copySize = mm_usable_size(ptr);
+        goto copy;
+    }
+
+    /* Sizes no heap block can hold may still be mapped by mm_malloc */
+    if (size > MAX_HEAP) {
+        copySize = GET_SIZE(HDRP(ptr)) - WSIZE;
+        goto copy;
+    }
+
+    asize = adjust_size(size);
+    csize = GET_SIZE(HDRP(ptr));
+    prev = GET_PREV_ALLOC(HDRP(ptr));
+    copySize = csize - WSIZE;
+
+    /* Shrink (or keep) in place, freeing any big enough tail */
+    if (asize <= csize) {
+        if (asize < csize)
+            realloc_stats.shrink++;
+        else
+            realloc_stats.fit++;
+        split_tail(ptr, asize);
+        return ptr;
+    }
+
+    /* Grow into the next block if it is free and big enough */
+    next = NEXT_BLKP(ptr);
+    nsize = GET_ALLOC(HDRP(next)) ? 0 : GET_SIZE(HDRP(next));
+    if (csize + nsize >= asize) {
+        realloc_stats.grow++;
+        remove_block(next);
+        PUT(HDRP(ptr), PACK(csize + nsize, prev | 1));
+        set_prev_alloc(NEXT_BLKP(ptr), 1);
+        split_tail(ptr, asize);
+        return ptr;
+    }
+
+    /* Grow by extending the heap if we (plus a free block) end it */
+    if (HDRP(NEXT_BLKP(nsize ? next : ptr)) == epilogue &&
+        epilogue + WSIZE == (char *)mem_heap_hi() + 1) {
+        if (mem_sbrk(asize - csize - nsize) == (void *)-1)
+            return NULL;
+        realloc_stats.extend++;
+        if (nsize)
+            remove_block(next);
+        PUT(HDRP(ptr), PACK(asize, prev | 1));
+        epilogue = HDRP(NEXT_BLKP(ptr));
+        PUT(epilogue, PACK(0, PREV_ALLOC | 1));
+        return ptr;
+    }
+
+    /* Fall back on copying to a new block */
+ copy:
     newptr = mm_malloc(size);
     if (newptr == NULL)
       return NULL;
-    copySize = *(size_t *)((char *)oldptr - SIZE_T_SIZE);
+    realloc_stats.copy++;
     if (size < copySize)
       copySize = size;
     memcpy(newptr, oldptr, copySize);
     mm_free(oldptr);
     return newptr;
 }
+
+/*
+ * mm_memalign - Allocate a block whose payload address is a multiple
+ *     of alignment, a power of two, returning the padding in front of
+ *     it to the free lists.
+ */
+void *mm_memalign(size_t alignment, size_t size)
+{
+    size_t asize, csize, lead;
+    char *bp;
+
+    if (alignment <= ALIGNMENT)
+        return mm_malloc(size);
+    if (size == 0 || (alignment & (alignment - 1)))
+        return NULL;
+    if (size > MAX_HEAP || alignment > MAX_HEAP)
+        return NULL;
+
+    /* Enough for the block after a lead of [MIN_BLOCK, MIN_BLOCK+align) */
+    asize = adjust_size(size);
+    if ((bp = find_fit(asize + alignment + MIN_BLOCK)) == NULL &&
+        (bp = extend_heap(asize + alignment + MIN_BLOCK)) == NULL)
+        return NULL;
+
+    /* Free the lead, unless bp is aligned already */
+    lead = -(size_t)bp & (alignment - 1);
+    if (lead > 0) {
+        while (lead < MIN_BLOCK)
+            lead += alignment;
+        csize = GET_SIZE(HDRP(bp));
+        PUT(HDRP(bp), PACK(lead, GET_PREV_ALLOC(HDRP(bp))));
+        PUT(FTRP(bp), PACK(lead, 0));
+        insert_block(bp);
+        bp += lead;
+        PUT(HDRP(bp), PACK(csize - lead, 0));
+    }
+    place(bp, asize);
+    return bp;
+}
+
+/*
+ * mm_usable_size - Return the number of payload bytes in block ptr
+ */
+size_t mm_usable_size(void *ptr)
+{
+    if (slab_owns(ptr))
+        return slab_usable_size(ptr);
+    if (IS_MAPPED(ptr))
+        return MAP_LEN(ptr) - MAP_HDR;
+    return GET_SIZE(HDRP(ptr)) - WSIZE;
+}
+
+/*
+ * mm_get_realloc_stats - Report how often each mm_realloc path ran
+ *     since the last mm_init.
+ */
+void mm_get_realloc_stats(mm_realloc_stats_t *stats)
+{
+    *stats = realloc_stats;
+}
+
+/*
+ * mm_heapinfo - Walk the heap and the free lists and describe them.
+ *     Gap blocks and the prologue are overhead, not allocated blocks.
+ */
+void mm_heapinfo(mm_heapinfo_t *info)
+{
+    char *bp;
+    size_t size, objs, bytes;
+    int i, k;
+
+    memset(info, 0, sizeof(*info));
+    info->heap_bytes = mem_heapsize() + mem_mapsize();
+    for (bp = NEXT_BLKP(heap_listp); GET_SIZE(HDRP(bp)) > 0;
+         bp = NEXT_BLKP(bp)) {
+        size = GET_SIZE(HDRP(bp));
+        if (IS_GAP(HDRP(bp)))
+            continue;
+        if (GET_ALLOC(HDRP(bp))) {
+            info->alloc_blocks++;
+            info->alloc_bytes += size;
+            continue;
+        }
+        info->free_blocks++;
+        info->free_bytes += size;
+        info->largest_free = MAX(info->largest_free, size);
+        k = (int)(8*sizeof(long) - 1) - __builtin_clzl(size);
+        info->free_hist[k < MM_INFO_BINS ? k : MM_INFO_BINS - 1]++;
+    }
+
+    /* Mapped blocks and slab objects are allocated blocks too */
+    info->alloc_blocks += nmapped;
+    info->alloc_bytes += mem_mapsize();
+    slab_usage(&objs, &bytes);
+    info->alloc_blocks += objs;
+    info->alloc_bytes += bytes;
+    info->slab_bytes = slab_bytes();
+    info->slab_free_bytes = info->slab_bytes - bytes;
+
+    /* One count per power-of-two class, over all of its lists */
+    info->nclasses = FL_COUNT;
+    for (i = 0; i < NUM_CLASSES; i++)
+        for (bp = seg_lists[i]; bp != NULL; bp = SUCC(bp))
+            info->class_len[i / SL_COUNT]++;
+}
+
+/*
+ * mm_checkheap - Check the heap and free lists for consistency.
+ *     Returns the number of problems found; prints every block when
+ *     verbose is set.
+ */
+int mm_checkheap(int verbose)
+{
+    char *bp;
+    int i, errs = 0;
+    size_t nfree = 0, nlisted = 0;
+
+    if (GET_SIZE(HDRP(heap_listp)) != ALIGNMENT ||
+        !GET_ALLOC(HDRP(heap_listp))) {
+        printf("mm_checkheap: bad prologue header\n");
+        errs++;
+    }
+
+    for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+        if (verbose)
+            printf("%p: size %zu %s\n", bp, (size_t)GET_SIZE(HDRP(bp)),
+                   GET_ALLOC(HDRP(bp)) ? "allocated" : "free");
+        if ((size_t)bp % ALIGNMENT) {
+            printf("mm_checkheap: %p is not aligned\n", bp);
+            errs++;
+        }
+        if (!GET_PREV_ALLOC(HDRP(NEXT_BLKP(bp))) != !GET_ALLOC(HDRP(bp))) {
+            printf("mm_checkheap: %p has the wrong prev-alloc bit after it\n",
+                   bp);
+            errs++;
+        }
+        if (!GET_ALLOC(HDRP(bp))) {
+            if (GET_SIZE(HDRP(bp)) != GET_SIZE(FTRP(bp))) {
+                printf("mm_checkheap: %p header does not match footer\n", bp);
+                errs++;
+            }
+            nfree++;
+            if (!GET_ALLOC(HDRP(NEXT_BLKP(bp)))) {
+                printf("mm_checkheap: %p escaped coalescing\n", bp);
+                errs++;
+            }
+        }
+    }
+    if (HDRP(bp) != epilogue) {
+        printf("mm_checkheap: epilogue is not at the end of the heap\n");
+        errs++;
+    }
+
+    for (i = 0; i < NUM_CLASSES; i++) {
+        if (((sl_map[i / SL_COUNT] >> (i % SL_COUNT)) & 1) !=
+            (seg_lists[i] != NULL)) {
+            printf("mm_checkheap: list %d disagrees with its bitmap\n", i);
+            errs++;
+        }
+        for (bp = seg_lists[i]; bp != NULL; bp = SUCC(bp)) {
+            nlisted++;
+            if (GET_ALLOC(HDRP(bp)) || size_class(GET_SIZE(HDRP(bp))) != i) {
+                printf("mm_checkheap: %p is on the wrong free list\n", bp);
+                errs++;
+            }
+            if (SUCC(bp) != NULL && PRED(SUCC(bp)) != bp) {
+                printf("mm_checkheap: %p has a broken succ link\n", bp);
+                errs++;
+            }
+        }
+    }
+    if (nfree != nlisted) {
+        printf("mm_checkheap: %zu free blocks but %zu listed\n",
+               nfree, nlisted);
+        errs++;
+    }
+    return errs;
+}
+
+/*
+ * The remaining routines are internal helper routines
+ */
+
+/*
+ * adjust_size - Convert a request size into a block size that holds
+ *     the payload plus a header and is big enough to be freed.
+ */
+static size_t adjust_size(size_t size)
+{
+    size_t asize = ALIGN(size + WSIZE);
+    return MAX(asize, MIN_BLOCK);
+}
+
+/*
+ * map_block - Allocate a block in a mem_map region of its own
+ */
+static void *map_block(size_t size)
+{
+    size_t len = (size + MAP_HDR + mem_pagesize() - 1) & ~(mem_pagesize() - 1);
+    char *p;
+
+    if ((p = mem_map(len)) == (void *)-1)
+        return NULL;
+    nmapped++;
+    MAP_LEN(p + MAP_HDR) = len;
+    return p + MAP_HDR;
+}
+
+/*
+ * remap_block - Resize mapped block bp to hold size bytes, maybe moving
+ *     it. Returns NULL if the region cannot be resized.
+ */
+static void *remap_block(void *bp, size_t size)
+{
+    size_t len = (size + MAP_HDR + mem_pagesize() - 1) & ~(mem_pagesize() - 1);
+    char *p;
+
+    if ((p = mem_remap((char *)bp - MAP_HDR, len)) == (void *)-1)
+        return NULL;
+    MAP_LEN(p + MAP_HDR) = len;
+    return p + MAP_HDR;
+}
+
+/*
+ * trim_heap - If free block bp is big and ends the heap, shrink the heap
+ *     by it and return 1; otherwise return 0.
+ */
+static int trim_heap(void *bp)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+
+    if (size < TRIM_THRESHOLD || HDRP(NEXT_BLKP(bp)) != epilogue ||
+        epilogue + WSIZE != (char *)mem_heap_hi() + 1)
+        return 0;
+    if (mem_sbrk(-(int)size) == (void *)-1)
+        return 0;
+    epilogue = HDRP(bp);
+    PUT(epilogue, PACK(0, GET_PREV_ALLOC(epilogue) | 1));
+    return 1;
+}
+
+/*
+ * release_block - Hand the whole pages of [lo, hi) inside a big free
+ *     block back to the system, keeping its header, links and footer
+ */
+static void release_block(void *bp, char *lo, char *hi)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+
+    lo = MAX(lo, (char *)bp + DSIZE);
+    hi = MIN(hi, FTRP(bp));
+    if (size >= RELEASE_THRESHOLD && lo < hi)
+        mem_release(lo, hi - lo);
+}
+
+/*
+ * extend_heap - Extend the heap so that a free block of at least size
+ *     bytes sits at its end, unless one already does, and return that
+ *     block (not on any list).
+ */
+static void *extend_heap(size_t size)
+{
+    char *bp, *gap;
+    size_t lastsize = 0;
+
+    if (epilogue + WSIZE != (char *)mem_heap_hi() + 1) {
+        /* Slab pages lie past the epilogue: cover them with a gap block */
+        size = MAX(size, CHUNKSIZE);
+        if ((long)(gap = mem_sbrk(PAD + size + WSIZE)) == -1)
+            return NULL;
+        bp = gap + PAD + WSIZE;
+        PUT(epilogue, PACK(HDRP(bp) - epilogue,
+                           GET_PREV_ALLOC(epilogue) | GAP | 1));
+        PUT(HDRP(bp), PACK(size, PREV_ALLOC));
+    }
+    else {
+        /* Reuse a free block that borders the epilogue */
+        if (!GET_PREV_ALLOC(epilogue)) {
+            lastsize = GET_SIZE(epilogue - WSIZE);
+            if (lastsize >= size) {
+                /* find_fit gave up on its list before reaching it */
+                bp = epilogue + WSIZE - lastsize;
+                remove_block(bp);
+                return bp;
+            }
+            size -= lastsize;
+        }
+        if (lastsize == 0)
+            size = MAX(size, CHUNKSIZE);
+        if ((long)(bp = mem_sbrk(size)) == -1)
+            return NULL;
+        PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp))));
+    }
+
+    /* Initialize free block footer and the epilogue header */
+    PUT(FTRP(bp), PACK(size, 0));
+    epilogue = HDRP(NEXT_BLKP(bp));
+    PUT(epilogue, PACK(0, 1));
+
+    /* Coalesce with the old tail block, if it was free */
+    if (lastsize) {
+        bp = PREV_BLKP(bp);
+        remove_block(bp);
+        size += lastsize;
+        PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp))));
+        PUT(FTRP(bp), PACK(size, 0));
+    }
+    return bp;
+}
+
+/*
+ * coalesce - Boundary tag coalescing. Return ptr to coalesced block,
+ *     which is not on any free list.
+ */
+static void *coalesce(void *bp)
+{
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+    size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
+    size_t size = GET_SIZE(HDRP(bp));
+
+    if (prev_alloc && next_alloc) {           /* Case 1 */
+        set_prev_alloc(NEXT_BLKP(bp), 0);
+        return bp;
+    }
+
+    if (prev_alloc && !next_alloc) {          /* Case 2 */
+        remove_block(NEXT_BLKP(bp));
+        size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
+        PUT(HDRP(bp), PACK(size, PREV_ALLOC));
+        PUT(FTRP(bp), PACK(size, 0));
+    }
+    else if (!prev_alloc && next_alloc) {     /* Case 3 */
+        bp = PREV_BLKP(bp);
+        remove_block(bp);
+        size += GET_SIZE(HDRP(bp));
+        PUT(HDRP(bp), PACK(size, PREV_ALLOC));
+        PUT(FTRP(bp), PACK(size, 0));
+        set_prev_alloc(NEXT_BLKP(bp), 0);
+    }
+    else {                                    /* Case 4 */
+        remove_block(NEXT_BLKP(bp));
+        remove_block(PREV_BLKP(bp));
+        size += GET_SIZE(HDRP(PREV_BLKP(bp))) +
+            GET_SIZE(HDRP(NEXT_BLKP(bp)));
+        bp = PREV_BLKP(bp);
+        PUT(HDRP(bp), PACK(size, PREV_ALLOC));
+        PUT(FTRP(bp), PACK(size, 0));
+    }
+    return bp;
+}
+
+/*
+ * find_fit - Find a free block of at least asize bytes and take it off
+ *     its free list. Returns NULL if no free block is big enough.
+ */
+static void *find_fit(size_t asize)
+{
+    int c = size_class(asize);
+    char *bp, *best = NULL;
+    size_t size, bestsize = 0;
+    int n;
+
+    /* Bounded best fit within the request's own list */
+    for (bp = seg_lists[c], n = 0; bp != NULL && n < FIT_SCAN;
+         bp = SUCC(bp), n++) {
+        size = GET_SIZE(HDRP(bp));
+        if (size >= asize && (best == NULL || size < bestsize)) {
+            best = bp;
+            bestsize = size;
+            if (size == asize)
+                break;
+        }
+    }
+
+    /* Any block on a higher list is big enough */
+    if (best == NULL && (c = next_class(c + 1)) >= 0)
+        best = seg_lists[c];
+
+    if (best != NULL)
+        remove_block(best);
+    return best;
+}
+
+/*
+ * place - Place block of asize bytes at start of free block bp
+ *     and split if remainder would be at least minimum block size
+ */
+static void place(void *bp, size_t asize)
+{
+    size_t csize = GET_SIZE(HDRP(bp));
+    size_t prev = GET_PREV_ALLOC(HDRP(bp));
+
+    if ((csize - asize) >= MIN_BLOCK) {
+        PUT(HDRP(bp), PACK(asize, prev | 1));
+        bp = NEXT_BLKP(bp);
+        PUT(HDRP(bp), PACK(csize-asize, PREV_ALLOC));
+        PUT(FTRP(bp), PACK(csize-asize, 0));
+        insert_block(bp);
+    }
+    else {
+        PUT(HDRP(bp), PACK(csize, prev | 1));
+        set_prev_alloc(NEXT_BLKP(bp), 1);
+    }
+}
+
+/*
+ * split_tail - Shrink allocated block bp to asize bytes, freeing the
+ *     tail if it is at least the minimum block size
+ */
+static void split_tail(void *bp, size_t asize)
+{
+    size_t csize = GET_SIZE(HDRP(bp));
+    size_t prev = GET_PREV_ALLOC(HDRP(bp));
+
+    if ((csize - asize) >= MIN_BLOCK) {
+        PUT(HDRP(bp), PACK(asize, prev | 1));
+        bp = NEXT_BLKP(bp);
+        PUT(HDRP(bp), PACK(csize-asize, PREV_ALLOC));
+        PUT(FTRP(bp), PACK(csize-asize, 0));
+        insert_block(coalesce(bp));
+    }
+}
+
+/*
+ * set_prev_alloc - Record in the header of block bp (which may be the
+ *     epilogue) whether the block before it is allocated
+ */
+static void set_prev_alloc(void *bp, int alloc)
+{
+    if (alloc)
+        PUT(HDRP(bp), GET(HDRP(bp)) | PREV_ALLOC);
+    else
+        PUT(HDRP(bp), GET(HDRP(bp)) & ~(word_t)PREV_ALLOC);
+}
+
+/*
+ * size_class - Map a block size to the index of its free list: the
+ *     power-of-two class f, then the next SL_SHIFT bits below the top
+ */
+static int size_class(size_t size)
+{
+    int f = (int)(8*sizeof(long) - 1) - __builtin_clzl(size / MIN_BLOCK);
+    int s;
+
+    if (f >= FL_COUNT)
+        return NUM_CLASSES - 1;
+    s = (size >> (f + __builtin_ctzl(MIN_BLOCK) - SL_SHIFT)) & (SL_COUNT - 1);
+    return f * SL_COUNT + s;
+}
+
+/*
+ * next_class - Return the first non-empty free list at index c or
+ *     above, or -1 if there is none
+ */
+static int next_class(int c)
+{
+    int f = c / SL_COUNT;
+    unsigned int map;
+
+    if (c >= NUM_CLASSES)
+        return -1;
+    map = sl_map[f] & (~0U << (c % SL_COUNT));
+    if (map == 0) {
+        if ((map = fl_map & (~0U << (f + 1))) == 0)
+            return -1;
+        f = __builtin_ctz(map);
+        map = sl_map[f];
+    }
+    return f * SL_COUNT + __builtin_ctz(map);
+}
+
+/*
+ * insert_block - Push free block bp onto the head of its free list
+ */
+static void insert_block(void *bp)
+{
+    int c = size_class(GET_SIZE(HDRP(bp)));
+
+    SET_PRED(bp, NULL);
+    SET_SUCC(bp, seg_lists[c]);
+    if (seg_lists[c] != NULL)
+        SET_PRED(seg_lists[c], bp);
+    seg_lists[c] = bp;
+    sl_map[c / SL_COUNT] |= 1U << (c % SL_COUNT);
+    fl_map |= 1U << (c / SL_COUNT);
+}
+
+/*
+ * remove_block - Unlink free block bp from its free list
+ */
+static void remove_block(void *bp)
+{
+    int c;
+
+    if (SUCC(bp) != NULL)
+        SET_PRED(SUCC(bp), PRED(bp));
+    if (PRED(bp) != NULL) {
+        SET_SUCC(PRED(bp), SUCC(bp));
+        return;
+    }
+    c = size_class(GET_SIZE(HDRP(bp)));
+    if ((seg_lists[c] = SUCC(bp)) == NULL) {
+        sl_map[c / SL_COUNT] &= ~(1U << (c % SL_COUNT));
+        if (sl_map[c / SL_COUNT] == 0)
+            fl_map &= ~(1U << (c / SL_COUNT));
+    }
+}
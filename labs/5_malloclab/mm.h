@@ -4,3 +4,43 @@ extern int mm_init (void);
 extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, size_t size);
+extern void *mm_memalign(size_t alignment, size_t size);
+extern size_t mm_usable_size(void *ptr);
+extern int mm_checkheap(int verbose);
+
+/* How often each mm_realloc strategy ran since the last mm_init */
+typedef struct {
+    unsigned long shrink;  /* block was bigger than the new size needs */
+    unsigned long fit;     /* new size fit the block as it was */
+    unsigned long grow;    /* grew into a free next block */
+    unsigned long extend;  /* grew by extending the heap */
+    unsigned long copy;    /* fell back to malloc + memcpy + free */
+} mm_realloc_stats_t;
+
+extern void mm_get_realloc_stats(mm_realloc_stats_t *stats);
+
+/*
+ * A snapshot of the heap's layout.  Block counts and sizes include
+ * the allocator's own overhead (headers, footers, rounding), so the
+ * caller, which knows how many payload bytes are live, can split the
+ * waste into internal fragmentation (alloc_bytes - payload) and
+ * external fragmentation (free_bytes - largest_free).
+ */
+#define MM_INFO_CLASSES 32   /* free lists reported, at most */
+#define MM_INFO_BINS    32   /* free block size histogram bins */
+
+typedef struct {
+    size_t heap_bytes;       /* heap plus mapped regions */
+    size_t alloc_blocks;     /* allocated blocks, slab objects included */
+    size_t alloc_bytes;      /* ... and the bytes they take up */
+    size_t free_blocks;      /* free blocks on the free lists */
+    size_t free_bytes;       /* ... and the bytes they take up */
+    size_t largest_free;     /* size of the largest free block */
+    size_t slab_bytes;       /* heap bytes in slab pages */
+    size_t slab_free_bytes;  /* ... not holding live objects */
+    int nclasses;            /* free lists in class_len */
+    size_t class_len[MM_INFO_CLASSES];  /* blocks on each free list */
+    size_t free_hist[MM_INFO_BINS];     /* free blocks of size [2^k, 2^k+1) */
+} mm_heapinfo_t;
+
+extern void mm_heapinfo(mm_heapinfo_t *info);
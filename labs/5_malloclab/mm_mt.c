@@ -0,0 +1,362 @@
+/*
+ * mm_mt.c - Thread-safe front end to the mm malloc package.
+ *
+ * Requests of up to MT_MAX_SMALL bytes are rounded up to one of
+ * MT_CLASSES size classes, MT_GRAIN bytes apart.  Each thread keeps a
+ * LIFO list of free objects per class and serves mallocs and frees from
+ * it without taking any lock.  Objects move between a thread cache and
+ * a central per-class list in batches, so each central lock is taken
+ * once per batch:
+ *
+ *   - a thread whose list is empty pops a whole batch from the central
+ *     list, and if that is empty too, carves a batch out of mm.c;
+ *   - a thread whose list grows past two batches pushes one batch back,
+ *     and the central list returns batches to mm.c once it holds more
+ *     than MT_CENTRAL_MAX of them.
+ *
+ * Every object is an ordinary mm.c block, so its class is recovered on
+ * free from mm_usable_size and a block may be freed by any thread.
+ * Larger requests, and all calls into mm.c, go through heap_lock.
+ *
+ * mm_mt_init, like mm_init, must be called while no other thread is
+ * using the allocator.  It bumps a generation number so that thread
+ * caches left over from the previous heap are dropped on next use.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "mm.h"
+#include "mm_mt.h"
+
+#define MT_GRAIN       16                       /* class spacing */
+#define MT_MAX_SMALL   1024                     /* largest cached size */
+#define MT_CLASSES     (MT_MAX_SMALL / MT_GRAIN)
+#define MT_BATCH_BYTES 8192                     /* target bytes per batch */
+#define MT_MIN_BATCH   4
+#define MT_MAX_BATCH   32
+#define MT_CENTRAL_MAX 16                       /* batches per central list */
+
+/* Class of a request, the object size of a class, and its batch size */
+#define SIZE_CLASS(size)  (((size) + MT_GRAIN - 1) / MT_GRAIN - 1)
+#define CLASS_SIZE(c)     (((size_t)(c) + 1) * MT_GRAIN)
+#define BATCH(c)          (batch_size[c])
+
+/*
+ * Free objects are linked through their first word.  On a central list
+ * the head object of each batch links to the next batch through its
+ * second word, which is why MT_GRAIN must hold two pointers.
+ */
+#define NEXT_OBJ(p)    (*(void **)(p))
+#define NEXT_BATCH(p)  (*(void **)((char *)(p) + sizeof(void *)))
+
+/* A thread's free objects of one class */
+typedef struct {
+    void *head;
+    int count;
+} tlist_t;
+
+typedef struct {
+    unsigned long gen;           /* heap generation the lists belong to */
+    tlist_t lists[MT_CLASSES];
+} tcache_t;
+
+/* The shared free objects of one class, as a stack of full batches */
+typedef struct {
+    pthread_mutex_t lock;
+    void *batches;
+    int nbatches;
+} central_t;
+
+/* Global variables */
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+static central_t central[MT_CLASSES];
+static int batch_size[MT_CLASSES];
+static unsigned long generation;     /* changed only by mm_mt_init */
+static pthread_key_t tcache_key;
+static pthread_once_t tcache_once = PTHREAD_ONCE_INIT;
+static __thread tcache_t tcache;
+
+/* Internal helper routines */
+static void init_once(void);
+static tcache_t *get_tcache(void);
+static void tcache_exit(void *arg);
+static int refill(int c, tlist_t *l);
+static void drain(int c, tlist_t *l);
+static void release(void *obj, int n);
+
+/*
+ * mm_mt_init - Initialize the underlying mm package and empty the
+ *     central lists.
+ */
+int mm_mt_init(void)
+{
+    int c, rc;
+
+    pthread_once(&tcache_once, init_once);
+
+    pthread_mutex_lock(&heap_lock);
+    rc = mm_init();
+    generation++;
+    for (c = 0; c < MT_CLASSES; c++) {
+        central[c].batches = NULL;
+        central[c].nbatches = 0;
+    }
+    pthread_mutex_unlock(&heap_lock);
+    return rc;
+}
+
+/*
+ * mm_mt_malloc - Allocate a block, from the thread cache when small
+ */
+void *mm_mt_malloc(size_t size)
+{
+    tlist_t *l;
+    void *p;
+    int c;
+
+    if (size == 0)
+        return NULL;
+
+    if (size > MT_MAX_SMALL) {
+        pthread_mutex_lock(&heap_lock);
+        p = mm_malloc(size);
+        pthread_mutex_unlock(&heap_lock);
+        return p;
+    }
+
+    c = SIZE_CLASS(size);
+    l = &get_tcache()->lists[c];
+    if (l->head == NULL && refill(c, l) < 0)
+        return NULL;
+    p = l->head;
+    l->head = NEXT_OBJ(p);
+    l->count--;
+    return p;
+}
+
+/*
+ * mm_mt_free - Free a block into the calling thread's cache when small
+ */
+void mm_mt_free(void *ptr)
+{
+    size_t size;
+    tlist_t *l;
+    int c;
+
+    if (ptr == NULL)
+        return;
+
+    /* Blocks too small or too big for any class go straight back */
+    size = mm_usable_size(ptr);
+    if (size < MT_GRAIN || size > MT_MAX_SMALL) {
+        pthread_mutex_lock(&heap_lock);
+        mm_free(ptr);
+        pthread_mutex_unlock(&heap_lock);
+        return;
+    }
+
+    /* Round down: the block holds at least CLASS_SIZE(c) bytes */
+    c = size / MT_GRAIN - 1;
+    if (c < 0 || c >= MT_CLASSES) {
+        pthread_mutex_lock(&heap_lock);
+        mm_free(ptr);
+        pthread_mutex_unlock(&heap_lock);
+        return;
+    }
+    l = &get_tcache()->lists[c];
+    NEXT_OBJ(ptr) = l->head;
+    l->head = ptr;
+    if (++l->count > 2*BATCH(c))
+        drain(c, l);
+}
+
+/*
+ * mm_mt_realloc - Resize in place through mm_realloc when both sizes
+ *     are large, otherwise copy
+ */
+void *mm_mt_realloc(void *ptr, size_t size)
+{
+    size_t oldsize;
+    void *newptr;
+
+    if (ptr == NULL)
+        return mm_mt_malloc(size);
+    if (size == 0) {
+        mm_mt_free(ptr);
+        return NULL;
+    }
+
+    oldsize = mm_usable_size(ptr);
+    if (oldsize > MT_MAX_SMALL && size > MT_MAX_SMALL) {
+        pthread_mutex_lock(&heap_lock);
+        newptr = mm_realloc(ptr, size);
+        pthread_mutex_unlock(&heap_lock);
+        return newptr;
+    }
+    if (size <= oldsize)
+        return ptr;
+
+    if ((newptr = mm_mt_malloc(size)) == NULL)
+        return NULL;
+    memcpy(newptr, ptr, oldsize);
+    mm_mt_free(ptr);
+    return newptr;
+}
+
+/*
+ * mm_mt_memalign - Allocate an aligned block from mm.c under the heap
+ *     lock; it may end up in a thread cache once freed, like any block,
+ *     so it is made big enough for the smallest class
+ */
+void *mm_mt_memalign(size_t alignment, size_t size)
+{
+    void *p;
+
+    if (size < MT_GRAIN)
+        size = MT_GRAIN;
+    pthread_mutex_lock(&heap_lock);
+    p = mm_memalign(alignment, size);
+    pthread_mutex_unlock(&heap_lock);
+    return p;
+}
+
+/*
+ * The remaining routines are internal helper routines
+ */
+
+/*
+ * init_once - Set up the state that survives across mm_mt_init calls
+ */
+static void init_once(void)
+{
+    int c, n;
+
+    if (pthread_key_create(&tcache_key, tcache_exit) != 0) {
+        fprintf(stderr, "mm_mt_init: pthread_key_create failed\n");
+        exit(1);
+    }
+    for (c = 0; c < MT_CLASSES; c++) {
+        pthread_mutex_init(&central[c].lock, NULL);
+        n = MT_BATCH_BYTES / CLASS_SIZE(c);
+        batch_size[c] = (n < MT_MIN_BATCH) ? MT_MIN_BATCH :
+            (n > MT_MAX_BATCH) ? MT_MAX_BATCH : n;
+    }
+}
+
+/*
+ * get_tcache - Return the calling thread's cache, emptying it first if
+ *     it belongs to an earlier heap
+ */
+static tcache_t *get_tcache(void)
+{
+    tcache_t *tc = &tcache;
+
+    if (tc->gen != generation) {
+        memset(tc->lists, 0, sizeof(tc->lists));
+        tc->gen = generation;
+        pthread_setspecific(tcache_key, tc);
+    }
+    return tc;
+}
+
+/*
+ * tcache_exit - Thread exit destructor: hand the cached objects back
+ *     to mm.c
+ */
+static void tcache_exit(void *arg)
+{
+    tcache_t *tc = arg;
+    int c;
+
+    if (tc->gen != generation)
+        return;
+    for (c = 0; c < MT_CLASSES; c++) {
+        release(tc->lists[c].head, tc->lists[c].count);
+        tc->lists[c].head = NULL;
+        tc->lists[c].count = 0;
+    }
+}
+
+/*
+ * refill - Fill empty thread list l with one batch of class c objects,
+ *     from the central list if it has one, else from mm.c
+ */
+static int refill(int c, tlist_t *l)
+{
+    central_t *cl = &central[c];
+    void *batch, *p;
+    int i;
+
+    pthread_mutex_lock(&cl->lock);
+    if ((batch = cl->batches) != NULL) {
+        cl->batches = NEXT_BATCH(batch);
+        cl->nbatches--;
+    }
+    pthread_mutex_unlock(&cl->lock);
+
+    if (batch == NULL) {
+        pthread_mutex_lock(&heap_lock);
+        for (i = 0; i < BATCH(c); i++) {
+            if ((p = mm_malloc(CLASS_SIZE(c))) == NULL)
+                break;
+            NEXT_OBJ(p) = batch;
+            batch = p;
+        }
+        pthread_mutex_unlock(&heap_lock);
+        if (i == 0)
+            return -1;
+        l->head = batch;
+        l->count = i;
+        return 0;
+    }
+
+    l->head = batch;
+    l->count = BATCH(c);
+    return 0;
+}
+
+/*
+ * drain - Move one batch from overfull thread list l to the central
+ *     list of class c, or back to mm.c if the central list is full
+ */
+static void drain(int c, tlist_t *l)
+{
+    central_t *cl = &central[c];
+    void *batch = l->head, *last = batch;
+    int i, full;
+
+    /* Cut the batch off the thread list outside of any lock */
+    for (i = 1; i < BATCH(c); i++)
+        last = NEXT_OBJ(last);
+    l->head = NEXT_OBJ(last);
+    l->count -= BATCH(c);
+    NEXT_OBJ(last) = NULL;
+
+    pthread_mutex_lock(&cl->lock);
+    if (!(full = (cl->nbatches >= MT_CENTRAL_MAX))) {
+        NEXT_BATCH(batch) = cl->batches;
+        cl->batches = batch;
+        cl->nbatches++;
+    }
+    pthread_mutex_unlock(&cl->lock);
+
+    if (full)
+        release(batch, BATCH(c));
+}
+
+/*
+ * release - Free a chain of n objects back to mm.c
+ */
+static void release(void *obj, int n)
+{
+    void *next;
+
+    pthread_mutex_lock(&heap_lock);
+    for (; n > 0; n--, obj = next) {
+        next = NEXT_OBJ(obj);
+        mm_free(obj);
+    }
+    pthread_mutex_unlock(&heap_lock);
+}
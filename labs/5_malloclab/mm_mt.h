@@ -0,0 +1,15 @@
+/*
+ * mm_mt.h - Thread-safe front end to the mm malloc package.
+ *
+ * Small requests are served from per-thread caches that refill from,
+ * and drain to, a central free list per size class in batches.  Large
+ * requests go straight to mm.c under the heap lock.  Any thread may
+ * free any block.
+ */
+#include <stdio.h>
+
+extern int mm_mt_init(void);
+extern void *mm_mt_malloc(size_t size);
+extern void mm_mt_free(void *ptr);
+extern void *mm_mt_realloc(void *ptr, size_t size);
+extern void *mm_mt_memalign(size_t alignment, size_t size);
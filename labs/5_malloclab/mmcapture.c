@@ -0,0 +1,531 @@
+/*
+ * mmcapture.c - LD_PRELOAD interposer that records a program's calls
+ *     to malloc, calloc, realloc, and free as an mdriver trace.
+ *
+ * usage: MMCAPTURE_FILE=prog.rep LD_PRELOAD=./libmmcapture.so prog ...
+ *
+ * Each call is passed to the real allocator and then logged, with a
+ * sequence number from a global counter, into a buffer private to the
+ * calling thread.  A full buffer is appended to a raw log file in one
+ * write, so threads meet only on the counter and once per batch.  A
+ * thread's buffer is flushed when it exits, and every buffer when the
+ * program exits; the raw log is then sorted by sequence number and
+ * turned into a .rep trace:
+ *
+ *   - every address a call returns gets a block id, reused once the
+ *     block is freed, so num_ids grows with the most blocks live at
+ *     once rather than with the number of calls;
+ *   - realloc keeps the id of the block it resizes;
+ *   - frees of addresses allocated before capture began, or by
+ *     something other than these calls (posix_memalign, say), are
+ *     dropped, as are requests too large for the trace format;
+ *   - requests for 0 bytes are recorded as requests for 1 byte.
+ *
+ * Blocks still live at exit stay live in the trace.  Without
+ * MMCAPTURE_FILE the trace is written to mmcapture.<pid>.rep.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tracefmt.h"
+
+#define LOG_RECS   4096              /* records per thread buffer */
+#define BOOT_SIZE  (64*1024)         /* heap for calls made by dlsym */
+
+#define MIN(x, y)  ((x) < (y) ? (x) : (y))
+
+/* Thread-local storage must not itself call malloc */
+#define TLS __thread __attribute__((tls_model("initial-exec")))
+
+/* One logged call */
+typedef struct {
+    unsigned long long seq;   /* global order of the call */
+    void *ptr;                /* block returned, or freed */
+    void *old;                /* block passed to realloc */
+    size_t size;              /* bytes requested */
+    int type;                 /* ALLOC, FREE, or REALLOC */
+} rec_t;
+
+/* A thread's log buffer, on a list so exit can flush all of them */
+typedef struct logbuf {
+    struct logbuf *next;
+    struct logbuf *prev;
+    int count;
+    rec_t recs[LOG_RECS];
+} logbuf_t;
+
+/* The real allocator */
+static void *(*real_malloc)(size_t);
+static void *(*real_calloc)(size_t, size_t);
+static void *(*real_realloc)(void *, size_t);
+static void (*real_free)(void *);
+
+/* Capture state */
+static int capturing;                     /* cleared at exit */
+static int log_fd = -1;                   /* raw log */
+static char log_path[PATH_MAX + 8];
+static char rep_path[PATH_MAX];
+static unsigned long long next_seq;
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static logbuf_t *buffers;                 /* every live thread's buffer */
+static pthread_key_t buf_key;
+
+static TLS logbuf_t *my_buf;
+static TLS int in_hook;                   /* don't log our own calls */
+
+/* Bootstrap heap for the calloc that dlsym makes */
+static char boot_heap[BOOT_SIZE] __attribute__((aligned(16)));
+static size_t boot_used;
+
+/* Id assignment during conversion: open addressing from ptr to id */
+typedef struct {
+    void *ptr;
+    int id;
+} slot_t;
+
+static slot_t *slots;
+static size_t nslots, nused;
+
+static void capture_init(void) __attribute__((constructor));
+static void capture_fini(void) __attribute__((destructor));
+static void log_call(int type, void *ptr, void *old, size_t size);
+static logbuf_t *new_buf(void);
+static void flush_buf(logbuf_t *b);
+static void thread_exit(void *arg);
+static void *boot_alloc(size_t size);
+static void convert(void);
+static int cmp_seq(const void *a, const void *b);
+static int map_find(void *ptr);
+static void map_put(void *ptr, int id);
+static void map_remove(void *ptr);
+static void resolve(void);
+
+/*
+ * The interposed allocator entry points
+ */
+void *malloc(size_t size)
+{
+    void *p;
+
+    if (real_malloc == NULL)
+	resolve();
+    if (real_malloc == NULL)
+	return boot_alloc(size);
+    p = real_malloc(size);
+    if (capturing && !in_hook)
+	log_call(ALLOC, p, NULL, size);
+    return p;
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    void *p;
+
+    if (real_calloc == NULL)
+	return boot_alloc(nmemb * size);  /* dlsym calls this; it's zeroed */
+    p = real_calloc(nmemb, size);
+    if (capturing && !in_hook)
+	log_call(ALLOC, p, NULL, nmemb * size);
+    return p;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    void *p;
+
+    if (real_realloc == NULL)
+	resolve();
+    if ((char *)ptr >= boot_heap && (char *)ptr < boot_heap + BOOT_SIZE) {
+	/* Move a bootstrap block into the real heap */
+	if ((p = malloc(size)) != NULL)
+	    memcpy(p, ptr, MIN(size, 
+			       (size_t)(boot_heap + BOOT_SIZE - (char *)ptr)));
+	return p;
+    }
+    p = real_realloc(ptr, size);
+    if (capturing && !in_hook) {
+	if (ptr == NULL)
+	    log_call(ALLOC, p, NULL, size);
+	else if (size == 0 && p == NULL)
+	    log_call(FREE, ptr, NULL, 0);
+	else
+	    log_call(REALLOC, p, ptr, size);
+    }
+    return p;
+}
+
+void free(void *ptr)
+{
+    if (ptr == NULL ||
+	((char *)ptr >= boot_heap && (char *)ptr < boot_heap + BOOT_SIZE))
+	return;
+    if (real_free == NULL)
+	resolve();
+    /* Log first, so a later reuse of ptr gets a later sequence number */
+    if (capturing && !in_hook)
+	log_call(FREE, ptr, NULL, 0);
+    real_free(ptr);
+}
+
+/*
+ * The remaining routines are internal helper routines
+ */
+
+/*
+ * resolve - Look up the real allocator functions
+ */
+static void resolve(void)
+{
+    real_calloc = NULL;
+    real_malloc = dlsym(RTLD_NEXT, "malloc");
+    real_realloc = dlsym(RTLD_NEXT, "realloc");
+    real_free = dlsym(RTLD_NEXT, "free");
+    real_calloc = dlsym(RTLD_NEXT, "calloc");
+}
+
+/*
+ * capture_init - Open the raw log and start capturing
+ */
+static void capture_init(void)
+{
+    char *file = getenv("MMCAPTURE_FILE");
+
+    resolve();
+    if (file != NULL)
+	snprintf(rep_path, sizeof(rep_path), "%s", file);
+    else
+	snprintf(rep_path, sizeof(rep_path), "mmcapture.%d.rep", (int)getpid());
+    snprintf(log_path, sizeof(log_path), "%s.raw", rep_path);
+    if ((log_fd = open(log_path, O_RDWR | O_CREAT | O_TRUNC | O_APPEND,
+		       0644)) < 0) {
+	perror("mmcapture: open");
+	return;
+    }
+    if (pthread_key_create(&buf_key, thread_exit) != 0) {
+	fprintf(stderr, "mmcapture: pthread_key_create failed\n");
+	return;
+    }
+    capturing = 1;
+}
+
+/*
+ * capture_fini - Stop capturing, flush every buffer, and convert the
+ *     raw log into the trace
+ */
+static void capture_fini(void)
+{
+    logbuf_t *b;
+
+    if (!capturing)
+	return;
+    in_hook = 1;
+    pthread_mutex_lock(&log_lock);
+    capturing = 0;
+    pthread_mutex_unlock(&log_lock);
+    for (b = buffers; b != NULL; b = b->next)
+	flush_buf(b);
+    convert();
+    close(log_fd);
+    unlink(log_path);
+    in_hook = 0;
+}
+
+/*
+ * log_call - Append one call to the calling thread's buffer
+ */
+static void log_call(int type, void *ptr, void *old, size_t size)
+{
+    logbuf_t *b = my_buf;
+    rec_t *r;
+
+    if (b == NULL && (b = new_buf()) == NULL)
+	return;
+    r = &b->recs[b->count];
+    r->seq = __atomic_fetch_add(&next_seq, 1, __ATOMIC_RELAXED);
+    r->type = type;
+    r->ptr = ptr;
+    r->old = old;
+    r->size = size;
+    if (++b->count == LOG_RECS)
+	flush_buf(b);
+}
+
+/*
+ * new_buf - Give the calling thread a log buffer
+ */
+static logbuf_t *new_buf(void)
+{
+    logbuf_t *b;
+
+    b = mmap(NULL, sizeof(logbuf_t), PROT_READ | PROT_WRITE,
+	     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (b == MAP_FAILED)
+	return NULL;
+    b->count = 0;
+    b->prev = NULL;
+    pthread_mutex_lock(&log_lock);
+    b->next = buffers;
+    if (buffers != NULL)
+	buffers->prev = b;
+    buffers = b;
+    pthread_mutex_unlock(&log_lock);
+
+    in_hook = 1;                 /* pthread_setspecific may allocate */
+    pthread_setspecific(buf_key, b);
+    in_hook = 0;
+    my_buf = b;
+    return b;
+}
+
+/*
+ * flush_buf - Append the records in buffer b to the raw log
+ */
+static void flush_buf(logbuf_t *b)
+{
+    size_t len = b->count * sizeof(rec_t), done = 0;
+    ssize_t n;
+
+    pthread_mutex_lock(&log_lock);
+    while (done < len && (n = write(log_fd, (char *)b->recs + done,
+				    len - done)) > 0)
+	done += n;
+    pthread_mutex_unlock(&log_lock);
+    b->count = 0;
+}
+
+/*
+ * thread_exit - Thread exit destructor: flush and drop the buffer
+ */
+static void thread_exit(void *arg)
+{
+    logbuf_t *b = arg;
+
+    flush_buf(b);
+    pthread_mutex_lock(&log_lock);
+    if (b->prev != NULL)
+	b->prev->next = b->next;
+    else
+	buffers = b->next;
+    if (b->next != NULL)
+	b->next->prev = b->prev;
+    pthread_mutex_unlock(&log_lock);
+    my_buf = NULL;
+    munmap(b, sizeof(logbuf_t));
+}
+
+/*
+ * boot_alloc - Serve allocations made before the real allocator is
+ *     known from a static array; they are never freed
+ */
+static void *boot_alloc(size_t size)
+{
+    char *p;
+
+    size = (size + 15) & ~(size_t)15;
+    if (size > BOOT_SIZE - boot_used)
+	return NULL;
+    p = boot_heap + boot_used;
+    boot_used += size;
+    return p;
+}
+
+/*
+ * convert - Turn the raw log into a .rep trace at rep_path
+ */
+static void convert(void)
+{
+    struct stat st;
+    rec_t *recs, *r;
+    size_t i, nrecs;
+    int *free_ids, nfree = 0, next_id = 0, id, old;
+    long long nops = 0, live = 0, peak = 0;
+    size_t *sizes = NULL, size_cap = 0;
+    FILE *fp;
+
+    if (fstat(log_fd, &st) < 0 || st.st_size == 0)
+	return;
+    recs = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		log_fd, 0);
+    if (recs == MAP_FAILED) {
+	perror("mmcapture: mmap");
+	return;
+    }
+    nrecs = st.st_size / sizeof(rec_t);
+    qsort(recs, nrecs, sizeof(rec_t), cmp_seq);
+
+    if ((fp = fopen(rep_path, "w")) == NULL) {
+	perror("mmcapture: fopen");
+	munmap(recs, st.st_size);
+	return;
+    }
+    free_ids = malloc(nrecs * sizeof(int));
+    nslots = 1024;
+    slots = calloc(nslots, sizeof(slot_t));
+    if (free_ids == NULL || slots == NULL) {
+	fprintf(stderr, "mmcapture: out of memory converting the log\n");
+	exit(1);
+    }
+
+    /* Placeholder header, padded so the real one fits over it */
+    fprintf(fp, "%20d\n%20d\n%20d\n%20d\n", 0, 0, 0, 0);
+
+    for (i = 0, r = recs; i < nrecs; i++, r++) {
+	if (r->size > INT_MAX)
+	    continue;
+	if (r->size == 0)
+	    r->size = 1;
+
+	/* A realloc of an unknown block is an alloc as far as we know */
+	old = -1;
+	if (r->type == REALLOC && (old = map_find(r->old)) < 0)
+	    r->type = ALLOC;
+
+	/* An address handed out again was freed behind our back */
+	if (r->type != FREE && r->ptr != NULL &&
+	    (id = map_find(r->ptr)) >= 0 && id != old) {
+	    fprintf(fp, "f %d\n", id);
+	    map_remove(r->ptr);
+	    live -= sizes[id];
+	    free_ids[nfree++] = id;
+	    nops++;
+	}
+
+	switch (r->type) {
+	case ALLOC:
+	    if (r->ptr == NULL)
+		continue;
+	    id = (nfree > 0) ? free_ids[--nfree] : next_id++;
+	    if (id >= size_cap) {
+		size_cap = (size_cap == 0) ? 1024 : 2*size_cap;
+		if ((sizes = realloc(sizes, size_cap * sizeof(size_t))) == NULL) {
+		    fprintf(stderr, "mmcapture: out of memory\n");
+		    exit(1);
+		}
+	    }
+	    map_put(r->ptr, id);
+	    sizes[id] = r->size;
+	    live += r->size;
+	    fprintf(fp, "a %d %zu\n", id, r->size);
+	    break;
+
+	case REALLOC:
+	    if (r->ptr == NULL)
+		continue;
+	    map_remove(r->old);
+	    map_put(r->ptr, old);
+	    live += r->size - sizes[old];
+	    sizes[old] = r->size;
+	    fprintf(fp, "r %d %zu\n", old, r->size);
+	    break;
+
+	case FREE:
+	    if ((id = map_find(r->ptr)) < 0)
+		continue;
+	    map_remove(r->ptr);
+	    live -= sizes[id];
+	    free_ids[nfree++] = id;
+	    fprintf(fp, "f %d\n", id);
+	    break;
+	}
+	nops++;
+	if (live > peak)
+	    peak = live;
+    }
+
+    rewind(fp);
+    fprintf(fp, "%20lld\n%20d\n%20lld\n%20d\n",
+	    (peak > INT_MAX) ? INT_MAX : peak, next_id, nops, 1);
+    fclose(fp);
+    free(free_ids);
+    free(sizes);
+    free(slots);
+    munmap(recs, st.st_size);
+}
+
+/*
+ * cmp_seq - qsort comparison of two records by sequence number
+ */
+static int cmp_seq(const void *a, const void *b)
+{
+    unsigned long long x = ((rec_t *)a)->seq, y = ((rec_t *)b)->seq;
+
+    return (x > y) - (x < y);
+}
+
+/* Home slot of an address in the table */
+#define HASH(p) ((((size_t)(p) >> 4) * 0x9E3779B97F4A7C15ULL) & (nslots - 1))
+
+/*
+ * map_find - Return the id of the live block at ptr, or -1
+ */
+static int map_find(void *ptr)
+{
+    size_t i;
+
+    for (i = HASH(ptr); slots[i].ptr != NULL; i = (i + 1) & (nslots - 1))
+	if (slots[i].ptr == ptr)
+	    return slots[i].id;
+    return -1;
+}
+
+/*
+ * map_put - Record that the block at ptr has id, growing the table
+ *     when it gets half full
+ */
+static void map_put(void *ptr, int id)
+{
+    slot_t *old = slots;
+    size_t i, n = nslots;
+
+    if (2 * (nused + 1) > nslots) {
+	nslots *= 2;
+	if ((slots = calloc(nslots, sizeof(slot_t))) == NULL) {
+	    fprintf(stderr, "mmcapture: out of memory\n");
+	    exit(1);
+	}
+	nused = 0;
+	for (i = 0; i < n; i++)
+	    if (old[i].ptr != NULL)
+		map_put(old[i].ptr, old[i].id);
+	free(old);
+    }
+    for (i = HASH(ptr); slots[i].ptr != NULL; i = (i + 1) & (nslots - 1))
+	;
+    slots[i].ptr = ptr;
+    slots[i].id = id;
+    nused++;
+}
+
+/*
+ * map_remove - Forget the block at ptr, shifting back any later entries
+ *     of its probe run so that lookups need no tombstones
+ */
+static void map_remove(void *ptr)
+{
+    size_t i, j, home;
+
+    for (i = HASH(ptr); slots[i].ptr != ptr; i = (i + 1) & (nslots - 1))
+	if (slots[i].ptr == NULL)
+	    return;
+    nused--;
+    for (j = i; ; ) {
+	slots[i].ptr = NULL;
+	do {
+	    j = (j + 1) & (nslots - 1);
+	    if (slots[j].ptr == NULL)
+		return;
+	    home = HASH(slots[j].ptr);
+	} while (i <= j ? (i < home && home <= j) : (i < home || home <= j));
+	slots[i] = slots[j];
+	i = j;
+    }
+}
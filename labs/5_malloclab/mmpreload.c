@@ -0,0 +1,250 @@
+/*
+ * mmpreload.c - Runs the mm.h allocator as a program's malloc.
+ *
+ * usage: LD_PRELOAD=./libmm.so prog ...
+ *
+ * libmm.so exports malloc, calloc, realloc, free, posix_memalign,
+ * memalign, aligned_alloc, and malloc_usable_size, all passed to the
+ * allocator built into it (mm.c, or mm-buddy.c with BACKEND=buddy).
+ * Its heap is memlib-mmap.c: a real mmap'd reservation of MAX_HEAP
+ * bytes rather than memlib.c's simulated heap, so nothing underneath
+ * calls back into malloc and no dlsym bootstrap is needed.  The heap
+ * is set up by the first call.
+ *
+ * One global lock serializes every call, since mm.c is not thread
+ * safe.  A pthread_atfork handler holds it across fork, so the child
+ * of a threaded program gets a consistent heap.
+ *
+ * Requests for stricter alignment than ALIGNMENT go to mm_memalign,
+ * whose blocks free, realloc, and malloc_usable_size take like any
+ * other.
+ *
+ * free ignores pointers that are neither in the heap nor in a mem_map
+ * region: blocks that the dynamic loader allocated before libmm.so was
+ * in place.  realloc of such a pointer fails with ENOMEM.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "config.h"
+
+#define MAX_REQUEST (PTRDIFF_MAX / 2)   /* larger requests fail at once */
+
+/* The entry points are the library's only exported symbols */
+#define EXPORT __attribute__((visibility("default")))
+
+/* Global variables */
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+static int initialized;                 /* heap set up */
+static int init_failed;                 /* ... and could not be */
+
+/* Internal helper routines */
+static void preload_init(void) __attribute__((constructor));
+static void lock_heap(void);
+static void unlock_heap(void);
+static int start_heap(void);
+static int owns(void *ptr);
+static void *aligned_block(size_t align, size_t size);
+
+/*
+ * The exported allocator entry points
+ */
+EXPORT void *malloc(size_t size)
+{
+    void *p = NULL;
+
+    if (size > MAX_REQUEST) {
+	errno = ENOMEM;
+	return NULL;
+    }
+    lock_heap();
+    if (start_heap() == 0)
+	p = mm_malloc(size ? size : 1);
+    unlock_heap();
+    if (p == NULL)
+	errno = ENOMEM;
+    return p;
+}
+
+EXPORT void *calloc(size_t nmemb, size_t size)
+{
+    size_t bytes;
+    void *p = NULL;
+
+    if (__builtin_mul_overflow(nmemb, size, &bytes) || bytes > MAX_REQUEST) {
+	errno = ENOMEM;
+	return NULL;
+    }
+    /* 
+     * Call mm_malloc rather than malloc: gcc turns malloc followed by
+     * memset into a call to calloc, which would be this function
+     */
+    lock_heap();
+    if (start_heap() == 0)
+	p = mm_malloc(bytes ? bytes : 1);
+    unlock_heap();
+    if (p == NULL) {
+	errno = ENOMEM;
+	return NULL;
+    }
+    /* mm.c reuses freed blocks, so the payload has to be cleared */
+    memset(p, 0, bytes);
+    return p;
+}
+
+EXPORT void *realloc(void *ptr, size_t size)
+{
+    char *p = NULL;
+
+    if (ptr == NULL)
+	return malloc(size);
+    if (size == 0) {
+	free(ptr);
+	return NULL;
+    }
+    if (size > MAX_REQUEST) {
+	errno = ENOMEM;
+	return NULL;
+    }
+
+    lock_heap();
+    if (owns(ptr))
+	p = mm_realloc(ptr, size);
+    unlock_heap();
+    if (p == NULL)
+	errno = ENOMEM;
+    return p;
+}
+
+EXPORT void free(void *ptr)
+{
+    if (ptr == NULL)
+	return;
+    lock_heap();
+    if (owns(ptr))
+	mm_free(ptr);
+    unlock_heap();
+}
+
+EXPORT int posix_memalign(void **memptr, size_t align, size_t size)
+{
+    void *p;
+
+    if (align < sizeof(void *) || (align & (align - 1)))
+	return EINVAL;
+    if ((p = aligned_block(align, size)) == NULL)
+	return ENOMEM;
+    *memptr = p;
+    return 0;
+}
+
+EXPORT void *memalign(size_t align, size_t size)
+{
+    void *p;
+
+    if (align == 0 || (align & (align - 1))) {
+	errno = EINVAL;
+	return NULL;
+    }
+    if ((p = aligned_block(align, size)) == NULL)
+	errno = ENOMEM;
+    return p;
+}
+
+EXPORT void *aligned_alloc(size_t align, size_t size)
+{
+    return memalign(align, size);
+}
+
+EXPORT size_t malloc_usable_size(void *ptr)
+{
+    size_t n = 0;
+
+    if (ptr == NULL)
+	return 0;
+    lock_heap();
+    if (owns(ptr))
+	n = mm_usable_size(ptr);
+    unlock_heap();
+    return n;
+}
+
+/*
+ * The remaining routines are internal helper routines
+ */
+
+/*
+ * preload_init - Hold the heap lock across fork
+ */
+static void preload_init(void)
+{
+    pthread_atfork(lock_heap, unlock_heap, unlock_heap);
+}
+
+/*
+ * lock_heap, unlock_heap - Take and drop the global heap lock
+ */
+static void lock_heap(void)
+{
+    pthread_mutex_lock(&heap_lock);
+}
+
+static void unlock_heap(void)
+{
+    pthread_mutex_unlock(&heap_lock);
+}
+
+/*
+ * start_heap - Set up the heap on first use.  Returns 0 once it is
+ *     ready, -1 if it could not be set up.  Called with the lock held.
+ */
+static int start_heap(void)
+{
+    if (!initialized) {
+	initialized = 1;
+	mem_init();
+	if (mem_heap_lo() == NULL || mm_init() < 0)
+	    init_failed = 1;
+    }
+    return init_failed ? -1 : 0;
+}
+
+/*
+ * owns - Did ptr come from the allocator?  Called with the lock held.
+ */
+static int owns(void *ptr)
+{
+    if (!initialized || init_failed)
+	return 0;
+    if ((char *)ptr >= (char *)mem_heap_lo() &&
+	(char *)ptr <= (char *)mem_heap_hi())
+	return 1;
+    return mem_is_mapped(ptr, ptr);
+}
+
+/*
+ * aligned_block - Allocate size bytes at a multiple of align, a power
+ *     of two
+ */
+static void *aligned_block(size_t align, size_t size)
+{
+    void *p = NULL;
+
+    if (align <= ALIGNMENT)
+	return malloc(size);
+    if (size > MAX_REQUEST || align > MAX_REQUEST)
+	return NULL;
+
+    lock_heap();
+    if (start_heap() == 0)
+	p = mm_memalign(align, size ? size : 1);
+    unlock_heap();
+    return p;
+}
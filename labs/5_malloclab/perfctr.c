@@ -0,0 +1,181 @@
+/*
+ * perfctr.c - Hardware performance counters around a test function,
+ *     using Linux perf_event_open.
+ *
+ * perf_measure runs the test function reps times with every open
+ * counter enabled and keeps the counts of the run with the fewest
+ * cycles, in the spirit of fcyc's K-best scheme.  Without a cycle
+ * counter it keeps the run with the fewest of the first event that is
+ * counted.  Only user-level events are counted, which most
+ * perf_event_paranoid settings allow.
+ *
+ * On other systems, or where the kernel offers none of the events,
+ * perf_init returns 0 and perf_measure reports every event invalid.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "perfctr.h"
+
+char *perf_event_names[PERF_NEVENTS] = {
+    "cycles", "instructions", "cache-misses", "branch-misses",
+    "dTLB-load-misses", "page-faults"
+};
+
+static int fds[PERF_NEVENTS];
+static int nopen = -1;       /* events open, or -1 before perf_init */
+
+#ifdef __linux__
+
+/* What perf_event_open should count for each event */
+static struct {
+    unsigned int type;
+    unsigned long long config;
+} events[PERF_NEVENTS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+     (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+
+/*
+ * open_event - Open a disabled, user-only counter for event e of this
+ *     process; returns the descriptor or -1
+ */
+static int open_event(int e)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events[e].type;
+    attr.config = events[e].config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+	PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/*
+ * read_event - Return the count of the counter on fd, scaled up for
+ *     the time it was multiplexed out, or -1 if it never ran
+ */
+static double read_event(int fd)
+{
+    unsigned long long v[3];   /* value, time enabled, time running */
+
+    if (read(fd, v, sizeof(v)) != sizeof(v) || v[2] == 0)
+	return -1;
+    return (double)v[0] * ((double)v[1] / v[2]);
+}
+
+/*
+ * perf_init - Open a counter for every event the kernel will give us.
+ *     Returns the number opened; when verbose, says which are missing.
+ */
+int perf_init(int verbose)
+{
+    int e, err = 0;
+
+    if (nopen >= 0)
+	return nopen;
+    for (nopen = e = 0; e < PERF_NEVENTS; e++) {
+	if ((fds[e] = open_event(e)) >= 0)
+	    nopen++;
+	else {
+	    err = errno;
+	    if (verbose)
+		printf("perfctr: %s not available (%s)\n",
+		       perf_event_names[e], strerror(err));
+	}
+    }
+    return nopen;
+}
+
+/*
+ * perf_close - Close every counter.  Counters count the process that
+ *     opened them, so a forked child calls this and opens its own.
+ */
+void perf_close(void)
+{
+    int e;
+
+    for (e = 0; e < PERF_NEVENTS && nopen > 0; e++)
+	if (fds[e] >= 0)
+	    close(fds[e]);
+    nopen = -1;
+}
+
+/*
+ * perf_measure - Count events over the fastest of reps runs of f(argp)
+ */
+void perf_measure(test_funct f, void *argp, int reps, perf_counts_t *counts)
+{
+    double c[PERF_NEVENTS];
+    int e, r, key = -1;
+
+    memset(counts, 0, sizeof(*counts));
+    if (perf_init(0) == 0)
+	return;
+    for (e = 0; e < PERF_NEVENTS && key < 0; e++)
+	if (fds[e] >= 0)
+	    key = e;
+
+    for (r = 0; r < reps; r++) {
+	for (e = 0; e < PERF_NEVENTS; e++)
+	    if (fds[e] >= 0)
+		ioctl(fds[e], PERF_EVENT_IOC_RESET, 0);
+	for (e = 0; e < PERF_NEVENTS; e++)
+	    if (fds[e] >= 0)
+		ioctl(fds[e], PERF_EVENT_IOC_ENABLE, 0);
+	f(argp);
+	for (e = 0; e < PERF_NEVENTS; e++)
+	    if (fds[e] >= 0)
+		ioctl(fds[e], PERF_EVENT_IOC_DISABLE, 0);
+
+	for (e = 0; e < PERF_NEVENTS; e++)
+	    c[e] = (fds[e] >= 0) ? read_event(fds[e]) : -1;
+	if (r > 0 && c[key] >= counts->count[key])
+	    continue;
+	for (e = 0; e < PERF_NEVENTS; e++) {
+	    counts->valid[e] = (c[e] >= 0);
+	    counts->count[e] = (c[e] >= 0) ? c[e] : 0;
+	}
+    }
+}
+
+#else /* !__linux__ */
+
+int perf_init(int verbose)
+{
+    if (verbose)
+	printf("perfctr: no perf_event_open on this system\n");
+    return nopen = 0;
+}
+
+void perf_close(void)
+{
+    nopen = -1;
+}
+
+void perf_measure(test_funct f, void *argp, int reps, perf_counts_t *counts)
+{
+    memset(counts, 0, sizeof(*counts));
+}
+
+#endif
@@ -0,0 +1,42 @@
+/*
+ * perfctr.h - Hardware performance counters around a test function,
+ *     using Linux perf_event_open.
+ *
+ * Each event is opened on its own, so the events this machine (or
+ * this kernel's perf_event_paranoid setting) does not allow are simply
+ * left out.  Where the kernel multiplexes events, counts are scaled up
+ * by the fraction of the run they were actually counted for.
+ */
+#ifndef __PERFCTR_H_
+#define __PERFCTR_H_
+
+#include "fcyc.h"
+
+/* The events counted, in the order of perf_counts_t.count */
+enum {
+    PERF_CYCLES,         /* CPU cycles */
+    PERF_INSTRUCTIONS,   /* instructions retired */
+    PERF_CACHE_MISSES,   /* last-level cache misses */
+    PERF_BRANCH_MISSES,  /* mispredicted branches */
+    PERF_DTLB_MISSES,    /* data TLB load misses */
+    PERF_PAGE_FAULTS,    /* page faults (a software event) */
+    PERF_NEVENTS
+};
+
+typedef struct {
+    int valid[PERF_NEVENTS];     /* was each event counted? */
+    double count[PERF_NEVENTS];  /* how many times it occurred */
+} perf_counts_t;
+
+extern char *perf_event_names[PERF_NEVENTS];
+
+/* Open the counters; returns how many events can be counted */
+int perf_init(int verbose);
+
+/* Close the counters, so that a forked child can open its own */
+void perf_close(void);
+
+/* Count events over the fastest of reps runs of f(argp) */
+void perf_measure(test_funct f, void *argp, int reps, perf_counts_t *counts);
+
+#endif /* __PERFCTR_H_ */
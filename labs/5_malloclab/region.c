@@ -0,0 +1,168 @@
+/*
+ * region.c - Region allocator on top of mm.h.
+ *
+ * A region is a list of chunks from mm_malloc.  Objects are carved
+ * off the newest chunk by bumping a pointer; when it runs out, a new
+ * chunk of chunk_size bytes takes its place.  An object of more than
+ * a quarter of a chunk gets a chunk of its own, so that it does not
+ * waste the rest of the current one.
+ *
+ * The region header lives in its first chunk, behind the chunk header,
+ * so a region costs a single mm_malloc:
+ *
+ *     | chunk_t | region | obj | obj | ... |    | chunk_t | obj | ... |
+ *
+ * region_reset frees every chunk but the first and starts bumping
+ * from the beginning of the first again.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "region.h"
+#include "mm.h"
+#include "config.h"
+
+/* Rounds up to the nearest multiple of ALIGNMENT */
+#define ALIGN(size) (((size) + (ALIGNMENT-1)) & ~(size_t)(ALIGNMENT-1))
+
+typedef struct chunk {
+    struct chunk *next;   /* next chunk of the region */
+    size_t size;          /* bytes in the chunk, header included */
+} chunk_t;
+
+struct region {
+    chunk_t *chunks;      /* every chunk, newest first */
+    chunk_t *first;       /* the chunk holding this header */
+    char *start;          /* first object byte of the first chunk */
+    char *cur;            /* next free byte of the current chunk */
+    char *end;            /* end of the current chunk */
+    size_t chunk_size;    /* bytes in an ordinary chunk */
+    size_t bytes;         /* bytes in all chunks */
+};
+
+#define CHUNK_HDR  ALIGN(sizeof(chunk_t))
+#define REGION_HDR ALIGN(sizeof(region_t))
+
+/* Objects larger than this get a chunk of their own */
+#define BIG(r)     ((r)->chunk_size / 4)
+
+/* Internal helper routines */
+static void *alloc_chunk(region_t *r, size_t size);
+
+/*
+ * region_create - Make an empty region that takes chunks of chunk_size
+ *     bytes (REGION_CHUNK if 0) from mm_malloc. Returns NULL if there
+ *     is no memory for it.
+ */
+region_t *region_create(size_t chunk_size)
+{
+    chunk_t *c;
+    region_t *r;
+
+    if (chunk_size == 0)
+	chunk_size = REGION_CHUNK;
+    chunk_size = ALIGN(chunk_size);
+    if (chunk_size < 2 * (CHUNK_HDR + REGION_HDR))
+	chunk_size = 2 * (CHUNK_HDR + REGION_HDR);
+    if ((c = (chunk_t *)mm_malloc(chunk_size)) == NULL)
+	return NULL;
+    c->next = NULL;
+    c->size = chunk_size;
+
+    r = (region_t *)((char *)c + CHUNK_HDR);
+    r->chunks = r->first = c;
+    r->start = r->cur = (char *)r + REGION_HDR;
+    r->end = (char *)c + chunk_size;
+    r->chunk_size = chunk_size;
+    r->bytes = chunk_size;
+    return r;
+}
+
+/*
+ * region_alloc - Allocate size bytes from region r. The object lasts
+ *     until the next region_reset or region_destroy of r.
+ */
+void *region_alloc(region_t *r, size_t size)
+{
+    char *p;
+
+    if (size > ((size_t)-1 >> 1))
+	return NULL;
+    size = ALIGN(size ? size : 1);
+    if (size <= (size_t)(r->end - r->cur)) {
+	p = r->cur;
+	r->cur += size;
+	return p;
+    }
+    return alloc_chunk(r, size);
+}
+
+/*
+ * region_reset - Release every object of region r at once. Keeps
+ *     the first chunk for the objects to come.
+ */
+void region_reset(region_t *r)
+{
+    chunk_t *c, *next;
+
+    for (c = r->chunks; c != NULL; c = next) {
+	next = c->next;
+	if (c != r->first)
+	    mm_free(c);
+    }
+    r->chunks = r->first;
+    r->first->next = NULL;
+    r->cur = r->start;
+    r->end = (char *)r->first + r->first->size;
+    r->bytes = r->first->size;
+}
+
+/*
+ * region_destroy - Release region r and every object in it
+ */
+void region_destroy(region_t *r)
+{
+    chunk_t *first = r->first;
+
+    region_reset(r);
+    mm_free(first);
+}
+
+/*
+ * region_bytes - Return the bytes that region r holds from mm_malloc
+ */
+size_t region_bytes(region_t *r)
+{
+    return r->bytes;
+}
+
+/*
+ * The remaining routines are internal helper routines
+ */
+
+/*
+ * alloc_chunk - Allocate an object of size bytes, already aligned,
+ *     from a new chunk. A big object gets a chunk to itself, put
+ *     behind the current one so that bumping carries on there.
+ */
+static void *alloc_chunk(region_t *r, size_t size)
+{
+    chunk_t *c;
+    size_t csize = (size > BIG(r)) ? CHUNK_HDR + size : r->chunk_size;
+
+    if ((c = (chunk_t *)mm_malloc(csize)) == NULL)
+	return NULL;
+    c->size = csize;
+    r->bytes += csize;
+    if (size > BIG(r)) {
+	c->next = r->chunks->next;
+	r->chunks->next = c;
+    }
+    else {
+	c->next = r->chunks;
+	r->chunks = c;
+	r->cur = (char *)c + CHUNK_HDR + size;
+	r->end = (char *)c + csize;
+    }
+    return (char *)c + CHUNK_HDR;
+}
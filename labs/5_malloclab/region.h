@@ -0,0 +1,21 @@
+/*
+ * region.h - Region allocator on top of mm.h, for many short-lived
+ *     objects that all die together.
+ *
+ * A region hands out objects by bumping a pointer through chunks it
+ * takes from mm_malloc.  Objects are never freed one by one:
+ * region_reset releases all of them at once, in time proportional to
+ * the number of chunks, not of objects.  A region lives in the mm heap,
+ * so mm_init discards every region along with everything else.
+ */
+#include <stdio.h>
+
+#define REGION_CHUNK (16*(1<<10))  /* default bytes per chunk */
+
+typedef struct region region_t;
+
+extern region_t *region_create(size_t chunk_size);
+extern void *region_alloc(region_t *r, size_t size);
+extern void region_reset(region_t *r);
+extern void region_destroy(region_t *r);
+extern size_t region_bytes(region_t *r);
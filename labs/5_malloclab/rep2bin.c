@@ -0,0 +1,124 @@
+/*
+ * rep2bin.c - Convert a text .rep trace into the binary trace format
+ *     of tracefmt.h, which mdriver maps and replays without parsing.
+ *
+ * usage: rep2bin <in.rep> <out>
+ *
+ * The trace is converted one request at a time, so traces of any
+ * length convert in constant memory.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "tracefmt.h"
+
+#define MAXLINE 1024
+
+static void convert(FILE *in, FILE *out, char *inpath);
+static void die(char *path, char *msg);
+
+static char *outpath;
+
+int main(int argc, char **argv)
+{
+    FILE *in, *out;
+
+    if (argc != 3) {
+	fprintf(stderr, "usage: %s <in.rep> <out>\n", argv[0]);
+	exit(1);
+    }
+    if ((in = fopen(argv[1], "r")) == NULL) {
+	fprintf(stderr, "rep2bin: %s: %s\n", argv[1], strerror(errno));
+	exit(1);
+    }
+    outpath = argv[2];
+    if ((out = fopen(outpath, "w")) == NULL) {
+	fprintf(stderr, "rep2bin: %s: %s\n", outpath, strerror(errno));
+	exit(1);
+    }
+
+    convert(in, out, argv[1]);
+
+    fclose(in);
+    if (fclose(out) != 0)
+	die(outpath, strerror(errno));
+    return 0;
+}
+
+/*
+ * convert - Copy the header and every request of text trace in to
+ *     binary trace out, checking that the request count and ids agree
+ *     with the header as mdriver's read_trace does
+ */
+static void convert(FILE *in, FILE *out, char *inpath)
+{
+    tracehdr_t hdr;
+    traceop_t op;
+    char type[MAXLINE];
+    unsigned index, size, align, max_index = 0, num_ops = 0;
+    int h[4];
+
+    if (fscanf(in, "%d %d %d %d", &h[0], &h[1], &h[2], &h[3]) != 4)
+	die(inpath, "bad trace header");
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = TRACE_MAGIC;
+    hdr.version = TRACE_VERSION;
+    hdr.sugg_heapsize = h[0];
+    hdr.num_ids = h[1];
+    hdr.num_ops = h[2];
+    hdr.weight = h[3];
+    if (fwrite(&hdr, sizeof(hdr), 1, out) != 1)
+	die(outpath, strerror(errno));
+
+    while (fscanf(in, "%s", type) != EOF) {
+	memset(&op, 0, sizeof(op));
+	switch (type[0]) {
+	case 'a':
+	case 'r':
+	    if (fscanf(in, "%u %u", &index, &size) != 2)
+		die(inpath, "truncated request");
+	    op.type = (type[0] == 'a') ? ALLOC : REALLOC;
+	    op.size = size;
+	    break;
+	case 'm':
+	    if (fscanf(in, "%u %u %u", &index, &align, &size) != 3)
+		die(inpath, "truncated request");
+	    if (align == 0 || (align & (align - 1)))
+		die(inpath, "alignment is not a power of two");
+	    op.type = MEMALIGN;
+	    op.size = size;
+	    op.align = align;
+	    break;
+	case 'f':
+	    if (fscanf(in, "%u", &index) != 1)
+		die(inpath, "truncated request");
+	    op.type = FREE;
+	    break;
+	default:
+	    die(inpath, "bogus request type");
+	}
+	op.index = index;
+	max_index = (index > max_index) ? index : max_index;
+	if (fwrite(&op, sizeof(op), 1, out) != 1)
+	    die(outpath, strerror(errno));
+	num_ops++;
+    }
+
+    if (num_ops != hdr.num_ops)
+	die(inpath, "request count does not match the header");
+    if (max_index != hdr.num_ids - 1)
+	die(inpath, "block ids do not match the header");
+}
+
+/*
+ * die - Report an error about file path, remove the partial output,
+ *     and exit
+ */
+static void die(char *path, char *msg)
+{
+    fprintf(stderr, "rep2bin: %s: %s\n", path, msg);
+    remove(outpath);
+    exit(1);
+}
@@ -0,0 +1,262 @@
+/*
+ * slab.c - Slab allocator for small fixed-size requests.
+ *
+ * Requests of up to SLAB_MAX bytes are rounded up to one of
+ * SLAB_CLASSES object sizes: multiples of 8 up to 64 bytes, then eight
+ * evenly spaced sizes per power of two.  Objects of one size are carved
+ * out of a SLAB_SIZE-byte page obtained with mem_sbrk and aligned to
+ * SLAB_SIZE, so the slab header of an object is found by masking its
+ * address.  Objects carry no header of their own: the slab header
+ * keeps a bitmap with one set bit per free slot.
+ *
+ *     | slab_t: links, size, counts, bitmap | obj | obj | ... | obj |
+ *
+ * Slabs with free slots sit on a per-class partial list; a slab that
+ * empties completely goes on a pool of free pages that any class may
+ * reuse.  Slab pages are never handed back to mm.c.
+ *
+ * A byte map with one entry per page of the heap records which pages
+ * are slabs, so slab_owns can tell a slab object from an mm.c block.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "slab.h"
+#include "memlib.h"
+#include "config.h"
+
+#define SLAB_SHIFT   12
+#define SLAB_SIZE    (1 << SLAB_SHIFT)                /* bytes per slab */
+#define SLAB_CLASSES 32
+#define MAP_WORDS    (SLAB_SIZE / 8 / 64)             /* enough for 8B objs */
+#define MAX_PAGES    (MAX_HEAP / SLAB_SIZE + 1)
+
+typedef struct slab {
+    struct slab *next;          /* partial list or free page pool links */
+    struct slab *prev;
+    unsigned int size;          /* object size in bytes */
+    unsigned short cls;         /* size class */
+    unsigned short nobjs;       /* objects per slab */
+    unsigned short nfree;       /* free objects */
+    unsigned short hint;        /* lowest map word that may be nonzero */
+    unsigned long map[MAP_WORDS];  /* set bit = free slot */
+} slab_t;
+
+#define SLAB_HDR   ((sizeof(slab_t) + 7) & ~(size_t)7)
+
+/* Given an object pointer, its slab and its slot number */
+#define SLABP(p)   ((slab_t *)((size_t)(p) & ~(size_t)(SLAB_SIZE - 1)))
+#define SLOT(s, p) (((char *)(p) - (char *)(s) - SLAB_HDR) / (s)->size)
+
+/* Index of the heap page holding address p */
+#define PAGE_INDEX(p) \
+    (((size_t)(p) >> SLAB_SHIFT) - ((size_t)mem_heap_lo() >> SLAB_SHIFT))
+
+/* Global variables */
+static slab_t *partial[SLAB_CLASSES];  /* slabs with free slots */
+static slab_t *free_pages;             /* empty slabs of no class */
+static size_t npages;                  /* slab pages taken from the heap */
+static size_t used_objs;               /* objects allocated */
+static size_t used_bytes;              /* ... and their total size */
+static unsigned char page_map[MAX_PAGES];
+static unsigned int class_size[SLAB_CLASSES];
+static unsigned char size_to_class[SLAB_MAX / 8 + 1];
+
+/* Internal helper routines */
+static void init_classes(void);
+static slab_t *new_slab(int c);
+static void unlink_slab(slab_t *s);
+
+/*
+ * slab_init - Forget every slab; called from mm_init on a fresh heap
+ */
+void slab_init(void)
+{
+    if (class_size[0] == 0)
+        init_classes();
+    memset(partial, 0, sizeof(partial));
+    memset(page_map, 0, sizeof(page_map));
+    free_pages = NULL;
+    npages = used_objs = used_bytes = 0;
+}
+
+/*
+ * slab_alloc - Allocate an object of at least size bytes
+ */
+void *slab_alloc(size_t size)
+{
+    int c = size_to_class[(size + 7) >> 3];
+    slab_t *s = partial[c];
+    int w, bit;
+
+    if (s == NULL && (s = new_slab(c)) == NULL)
+        return NULL;
+
+    for (w = s->hint; s->map[w] == 0; w++)
+        ;
+    bit = __builtin_ctzl(s->map[w]);
+    s->map[w] &= ~(1UL << bit);
+    s->hint = w;
+    if (--s->nfree == 0)
+        unlink_slab(s);
+    used_objs++;
+    used_bytes += s->size;
+    return (char *)s + SLAB_HDR + (size_t)(w*64 + bit) * s->size;
+}
+
+/*
+ * slab_free - Return an object to its slab
+ */
+void slab_free(void *ptr)
+{
+    slab_t *s = SLABP(ptr);
+    size_t i = SLOT(s, ptr);
+    int w = i / 64;
+
+    s->map[w] |= 1UL << (i % 64);
+    if (w < s->hint)
+        s->hint = w;
+    used_objs--;
+    used_bytes -= s->size;
+
+    if (s->nfree++ == 0) {               /* was full: back to partial */
+        s->prev = NULL;
+        s->next = partial[s->cls];
+        if (s->next != NULL)
+            s->next->prev = s;
+        partial[s->cls] = s;
+    }
+    if (s->nfree == s->nobjs) {          /* empty: back to the pool */
+        unlink_slab(s);
+        s->next = free_pages;
+        free_pages = s;
+    }
+}
+
+/*
+ * slab_owns - Is ptr an object in some slab?  The test is bounded by
+ *     the fixed extent of the heap rather than its current break, so
+ *     mm_mt may call it without holding the heap lock while another
+ *     thread grows the heap.
+ */
+int slab_owns(void *ptr)
+{
+    return (char *)ptr >= (char *)mem_heap_lo() &&
+        PAGE_INDEX(ptr) < MAX_PAGES && page_map[PAGE_INDEX(ptr)];
+}
+
+/*
+ * slab_usable_size - Return the object size of the slab holding ptr
+ */
+size_t slab_usable_size(void *ptr)
+{
+    return SLABP(ptr)->size;
+}
+
+/*
+ * slab_class_size - Return the object size slab_alloc uses for a
+ *     request of size bytes, at most SLAB_MAX
+ */
+size_t slab_class_size(size_t size)
+{
+    return class_size[size_to_class[(size + 7) >> 3]];
+}
+
+/*
+ * slab_bytes - Return the number of heap bytes held in slab pages
+ */
+size_t slab_bytes(void)
+{
+    return npages * SLAB_SIZE;
+}
+
+/*
+ * slab_usage - Report the number of objects allocated from slabs and
+ *     the bytes they take up
+ */
+void slab_usage(size_t *objs, size_t *bytes)
+{
+    *objs = used_objs;
+    *bytes = used_bytes;
+}
+
+/*
+ * The remaining routines are internal helper routines
+ */
+
+/*
+ * init_classes - Build the class size table and the size lookup table
+ */
+static void init_classes(void)
+{
+    int c, k;
+    size_t size;
+
+    for (c = 0; c < 8; c++)
+        class_size[c] = 8 * (c + 1);
+    for (k = 0; c < SLAB_CLASSES; k++)
+        for (size = 72 << k; c < SLAB_CLASSES && size <= 128u << k;
+             size += 8 << k)
+            class_size[c++] = size;
+
+    for (c = 0, size = 0; size <= SLAB_MAX; size += 8) {
+        while (class_size[c] < size)
+            c++;
+        size_to_class[size >> 3] = c;
+    }
+}
+
+/*
+ * new_slab - Set up an empty slab for class c, from the free page pool
+ *     or else from a fresh SLAB_SIZE-aligned page of heap
+ */
+static slab_t *new_slab(int c)
+{
+    slab_t *s;
+    char *brk, *p;
+    size_t pad;
+    int i;
+
+    if ((s = free_pages) != NULL)
+        free_pages = s->next;
+    else {
+        brk = (char *)mem_heap_hi() + 1;
+        pad = -(size_t)brk & (SLAB_SIZE - 1);
+        if ((p = mem_sbrk(pad + SLAB_SIZE)) == (void *)-1)
+            return NULL;
+        s = (slab_t *)(p + pad);
+        page_map[PAGE_INDEX(s)] = 1;
+        npages++;
+    }
+
+    s->size = class_size[c];
+    s->cls = c;
+    s->nobjs = s->nfree = (SLAB_SIZE - SLAB_HDR) / s->size;
+    s->hint = 0;
+    memset(s->map, 0, sizeof(s->map));
+    for (i = 0; i < s->nobjs / 64; i++)
+        s->map[i] = ~0UL;
+    if (s->nobjs % 64)
+        s->map[i] = (1UL << (s->nobjs % 64)) - 1;
+
+    s->prev = NULL;
+    s->next = partial[c];
+    if (s->next != NULL)
+        s->next->prev = s;
+    partial[c] = s;
+    return s;
+}
+
+/*
+ * unlink_slab - Take slab s off its class's partial list
+ */
+static void unlink_slab(slab_t *s)
+{
+    if (s->prev != NULL)
+        s->prev->next = s->next;
+    else
+        partial[s->cls] = s->next;
+    if (s->next != NULL)
+        s->next->prev = s->prev;
+}
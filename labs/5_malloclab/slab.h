@@ -0,0 +1,16 @@
+/*
+ * slab.h - Slab allocator for small fixed-size requests, used by mm.c
+ *     in front of its general free lists.
+ */
+#include <stdio.h>
+
+#define SLAB_MAX 512   /* largest request served from a slab */
+
+extern void slab_init(void);
+extern void *slab_alloc(size_t size);
+extern void slab_free(void *ptr);
+extern int slab_owns(void *ptr);
+extern size_t slab_usable_size(void *ptr);
+extern size_t slab_class_size(size_t size);
+extern size_t slab_bytes(void);
+extern void slab_usage(size_t *objs, size_t *bytes);
@@ -0,0 +1,41 @@
+/*
+ * tracefmt.h - Trace requests and the binary trace file format shared
+ *     by mdriver and rep2bin.
+ *
+ * A binary trace is a tracehdr_t followed directly by num_ops packed
+ * traceop_t records, in the byte order of the machine that wrote it.
+ * mdriver maps the file and replays the records in place, so the
+ * record layout is fixed-width and identical in memory and on disk.
+ * Text .rep traces start with a decimal number, never with the magic
+ * number, so read_trace can tell the two formats apart.
+ */
+#ifndef __TRACEFMT_H_
+#define __TRACEFMT_H_
+
+#include <stdint.h>
+
+#define TRACE_MAGIC   0x5254414dU  /* "MATR" read as a little-endian word */
+#define TRACE_VERSION 2
+
+/* Request types */
+enum {ALLOC, FREE, REALLOC, MEMALIGN};
+
+/* Characterizes a single trace operation (allocator request) */
+typedef struct {
+    int32_t type;                     /* type of request */
+    int32_t index;                    /* index for free() to use later */
+    int32_t size;                     /* byte size of alloc/realloc request */
+    int32_t align;                    /* alignment of memalign, else 0 */
+} traceop_t;
+
+/* The header of a binary trace file */
+typedef struct {
+    uint32_t magic;          /* TRACE_MAGIC */
+    uint32_t version;        /* TRACE_VERSION */
+    uint32_t sugg_heapsize;  /* suggested heap size (unused) */
+    uint32_t num_ids;        /* number of alloc/realloc ids */
+    uint32_t num_ops;        /* number of traceop_t records that follow */
+    uint32_t weight;         /* weight for this trace (unused) */
+} tracehdr_t;
+
+#endif /* __TRACEFMT_H_ */
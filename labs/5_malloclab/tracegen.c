@@ -0,0 +1,535 @@
+/*
+ * tracegen.c - Generate synthetic allocator traces from workload models.
+ *
+ * usage: tracegen [options] <outfile>
+ *
+ * The generator keeps a working set of about W live blocks.  At each
+ * step it reallocates a live block with the given probability, and
+ * otherwise allocates a new block when fewer than W are live, or frees
+ * one when W or more are, with a 60/40 bias so that the number of live
+ * blocks wanders around W.  Block sizes come from a size model, and a
+ * lifetime model picks which block each free hits:
+ *
+ *   lifo       the youngest live block (stack discipline)
+ *   fifo       the oldest live block (queue discipline)
+ *   random     any live block
+ *   long,F     any live block, except that a fraction F of the working
+ *              set is allocated first and lives until the end
+ *
+ * A realloc always hits the youngest live block, the way a buffer that
+ * is being filled is grown a few times in a row, and changes its size
+ * by a growth pattern:
+ *
+ *   geom,F     to F times its size
+ *   linear,N   to N bytes more than its size
+ *   random     to a fresh size from the size model
+ *
+ * A given share of the new blocks are memalign requests, for an
+ * alignment that is a power of two between 16 bytes and a maximum,
+ * each power equally likely.
+ *
+ * Once the trace reaches its op count it frees every block still
+ * live, so traces are balanced like the default ones.  Ids of freed
+ * blocks are reused, so num_ids, and the memory mdriver needs to replay
+ * the trace, grows with the working set rather than with the length.
+ *
+ * The trace is written as it is generated, in the text .rep format or
+ * with -b in the binary format of tracefmt.h, and the header is filled
+ * in at the end, so <outfile> must be seekable.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+
+#include "tracefmt.h"
+
+#define MAXLINE 1024
+
+/* Size models */
+enum {UNIFORM, POWER, BIMODAL};
+
+/* Lifetime models */
+enum {LIFO, FIFO, RANDOM, LONG};
+
+/* Realloc growth patterns */
+enum {GEOMETRIC, LINEAR, RESAMPLE};
+
+/* The workload model, from the command line */
+static long long num_ops = 100000;        /* requests to generate, about */
+static long working_set = 1000;           /* live blocks to hover around */
+static int size_model = UNIFORM;
+static double size_arg[3] = {16, 512, 0}; /* size model parameters */
+static int life_model = RANDOM;
+static double long_frac = 0.0;            /* long-lived fraction of W */
+static double realloc_pct = 0.0;          /* chance a step is a realloc */
+static int growth = GEOMETRIC;
+static double growth_arg = 1.5;           /* growth factor or step */
+static long max_size = 1 << 20;           /* largest realloc result */
+static double memalign_pct = 0.0;         /* chance an alloc is a memalign */
+static long max_align = 4096;             /* largest memalign alignment */
+static int binary = 0;                    /* write the binary format? */
+static unsigned long long seed = 1;
+
+/* Generator state */
+static FILE *out;
+static char *outpath;
+static long long ops;                     /* requests written so far */
+static int *live;                         /* ring of live ids, oldest first */
+static long live_head, live_count, live_cap;
+static int *keep;                         /* long-lived ids */
+static long keep_count;
+static int *free_ids;                     /* stack of ids free for reuse */
+static long free_count, free_cap;
+static int next_id;                       /* ids handed out so far */
+static int *sizes;                        /* current size of each id */
+static long sizes_cap;
+static long long live_bytes, peak_bytes;
+
+static void generate(void);
+static int pick_live(void);
+static void put_live(int id);
+static int new_id(void);
+static int draw_size(void);
+static int grow_size(int size);
+static int draw_align(void);
+static void emit(int type, int id, int size, int align);
+static void write_header(void);
+static double uniform01(void);
+static void parse_model(char *arg, char **names, int nnames, int *model,
+			double *args, int nargs);
+static void *grow_array(void *p, long *cap, long need, size_t elt);
+static void usage(char *prog);
+static void die(char *msg);
+
+int main(int argc, char **argv)
+{
+    static char *size_names[] = {"uniform", "power", "bimodal"};
+    static char *life_names[] = {"lifo", "fifo", "random", "long"};
+    static char *growth_names[] = {"geom", "linear", "random"};
+    double args[3];
+    int c, pct;
+
+    while ((c = getopt(argc, argv, "n:w:s:l:r:g:M:a:A:S:bh")) != EOF) {
+	switch (c) {
+	case 'n': /* Number of requests */
+	    num_ops = (long long)strtod(optarg, NULL);
+	    break;
+	case 'w': /* Working set, in blocks */
+	    working_set = atol(optarg);
+	    break;
+	case 's': /* Size model */
+	    parse_model(optarg, size_names, 3, &size_model, size_arg, 3);
+	    break;
+	case 'l': /* Lifetime model */
+	    args[0] = 0.5;
+	    parse_model(optarg, life_names, 4, &life_model, args, 1);
+	    long_frac = args[0];
+	    break;
+	case 'r': /* Percentage of requests that are reallocs */
+	    pct = atoi(optarg);
+	    realloc_pct = pct / 100.0;
+	    break;
+	case 'g': /* Realloc growth pattern */
+	    args[0] = 0;
+	    parse_model(optarg, growth_names, 3, &growth, args, 1);
+	    growth_arg = (args[0] != 0) ? args[0] :
+		(growth == GEOMETRIC) ? 1.5 : 64;
+	    break;
+	case 'M': /* Largest size a realloc may grow a block to */
+	    max_size = atol(optarg);
+	    break;
+	case 'a': /* Percentage of allocations that are memaligns */
+	    pct = atoi(optarg);
+	    memalign_pct = pct / 100.0;
+	    break;
+	case 'A': /* Largest memalign alignment */
+	    max_align = atol(optarg);
+	    break;
+	case 'S': /* Random seed */
+	    seed = strtoull(optarg, NULL, 0);
+	    break;
+	case 'b': /* Write the binary format */
+	    binary = 1;
+	    break;
+	case 'h':
+	    usage(argv[0]);
+	    exit(0);
+	default:
+	    usage(argv[0]);
+	    exit(1);
+	}
+    }
+    if (optind != argc - 1) {
+	usage(argv[0]);
+	exit(1);
+    }
+    if (num_ops < 1 || working_set < 1 || max_size < 1 || max_size > INT_MAX ||
+	size_arg[0] < 1 || size_arg[1] < size_arg[0] || size_arg[1] > INT_MAX ||
+	long_frac < 0 || long_frac >= 1 || realloc_pct < 0 ||
+	realloc_pct >= 1 || memalign_pct < 0 || memalign_pct > 1 ||
+	max_align < 16 || max_align > (1 << 30) ||
+	(max_align & (max_align - 1))) {
+	fprintf(stderr, "%s: bad workload parameters\n", argv[0]);
+	exit(1);
+    }
+    if (seed == 0)               /* xorshift never leaves zero */
+	seed = 1;
+
+    outpath = argv[optind];
+    if ((out = fopen(outpath, "w")) == NULL) {
+	fprintf(stderr, "%s: %s: %s\n", argv[0], outpath, strerror(errno));
+	exit(1);
+    }
+    write_header();              /* placeholder until the counts are known */
+    generate();
+    write_header();
+    if (fclose(out) != 0)
+	die(strerror(errno));
+    return 0;
+}
+
+/*
+ * generate - Write the requests of the trace
+ */
+static void generate(void)
+{
+    long i, nkeep = 0;
+    int id, size;
+
+    /* The long-lived blocks come first */
+    if (life_model == LONG) {
+	nkeep = (long)(long_frac * working_set);
+	if ((keep = malloc(nkeep * sizeof(int))) == NULL)
+	    die("out of memory");
+	for (i = 0; i < nkeep; i++) {
+	    id = new_id();
+	    emit(ALLOC, id, draw_size(), 0);
+	    keep[keep_count++] = id;
+	}
+    }
+
+    /* Then the churn, until freeing what is left makes num_ops */
+    while (ops + live_count + keep_count < num_ops) {
+	if (live_count > 0 && uniform01() < realloc_pct) {
+	    id = live[(live_head + live_count - 1) % live_cap];
+	    size = (growth == RESAMPLE) ? draw_size() : grow_size(sizes[id]);
+	    emit(REALLOC, id, size, 0);
+	}
+	else if (live_count == 0 || uniform01() <
+		 ((live_count + keep_count < working_set) ? 0.6 : 0.4)) {
+	    id = new_id();
+	    if (uniform01() < memalign_pct)
+		emit(MEMALIGN, id, draw_size(), draw_align());
+	    else
+		emit(ALLOC, id, draw_size(), 0);
+	    put_live(id);
+	}
+	else {
+	    id = pick_live();
+	    emit(FREE, id, 0, 0);
+	    free_ids = grow_array(free_ids, &free_cap, free_count + 1,
+				  sizeof(int));
+	    free_ids[free_count++] = id;
+	}
+    }
+
+    /* Free everything, in ring order */
+    while (live_count > 0) {
+	emit(FREE, live[live_head], 0, 0);
+	live_head = (live_head + 1) % live_cap;
+	live_count--;
+    }
+    for (i = 0; i < keep_count; i++)
+	emit(FREE, keep[i], 0, 0);
+}
+
+/*
+ * pick_live - Remove a live block from the ring, chosen by the
+ *     lifetime model, and return its id
+ */
+static int pick_live(void)
+{
+    long pos, last = (live_head + live_count - 1) % live_cap;
+    int id;
+
+    switch (life_model) {
+    case LIFO:
+	pos = last;
+	break;
+    case FIFO:
+	id = live[live_head];
+	live_head = (live_head + 1) % live_cap;
+	live_count--;
+	return id;
+    default:
+	pos = (live_head + (long)(uniform01() * live_count)) % live_cap;
+	break;
+    }
+    id = live[pos];
+    live[pos] = live[last];      /* order only matters for lifo and fifo */
+    live_count--;
+    return id;
+}
+
+/*
+ * put_live - Add id to the young end of the ring of live blocks
+ */
+static void put_live(int id)
+{
+    long i, old = live_cap;
+
+    if (live_count == live_cap) {
+	live = grow_array(live, &live_cap, live_count + 1, sizeof(int));
+	/* Unwrap the ring into the new space */
+	for (i = 0; i < live_head; i++)
+	    live[old + i] = live[i];
+	if (live_head > 0)
+	    memmove(live, live + live_head, live_count * sizeof(int));
+	live_head = 0;
+    }
+    live[(live_head + live_count) % live_cap] = id;
+    live_count++;
+}
+
+/*
+ * new_id - Return an id for a new block, reusing a freed one if any
+ */
+static int new_id(void)
+{
+    if (free_count > 0)
+	return free_ids[--free_count];
+    if (next_id == INT_MAX)
+	die("too many live blocks");
+    sizes = grow_array(sizes, &sizes_cap, next_id + 1, sizeof(int));
+    return next_id++;
+}
+
+/*
+ * draw_size - Return a block size drawn from the size model
+ */
+static int draw_size(void)
+{
+    double lo = size_arg[0], hi = size_arg[1], a = size_arg[2], u, x;
+
+    u = uniform01();
+    switch (size_model) {
+    case POWER:
+	/* Inverse CDF of a power law p(x) ~ x^-a on [lo, hi] */
+	if (fabs(a - 1) < 1e-9)
+	    x = lo * pow(hi / lo, u);
+	else
+	    x = pow(pow(lo, 1 - a) + u * (pow(hi, 1 - a) - pow(lo, 1 - a)),
+		    1 / (1 - a));
+	break;
+    case BIMODAL:
+	/* Within 1/8 of lo with probability a, else within 1/8 of hi */
+	x = (uniform01() < a) ? lo : hi;
+	x += x / 8 * (2*u - 1);
+	break;
+    default:
+	x = lo + u * (hi - lo + 1);
+	break;
+    }
+    if (x < 1)
+	x = 1;
+    return (x > INT_MAX) ? INT_MAX : (int)x;
+}
+
+/*
+ * grow_size - Return the size a realloc grows a block of size bytes to
+ */
+static int grow_size(int size)
+{
+    double x;
+
+    x = (growth == GEOMETRIC) ? size * growth_arg : size + growth_arg;
+    if (x > max_size)
+	x = max_size;
+    return (x < 1) ? 1 : (int)x;
+}
+
+/*
+ * draw_align - Return a memalign alignment, a power of two in
+ *     [16, max_align] with every power equally likely
+ */
+static int draw_align(void)
+{
+    int n = __builtin_ctzl(max_align) - 4 + 1;
+
+    return 16 << (int)(uniform01() * n);
+}
+
+/*
+ * emit - Write one request to the trace
+ */
+static void emit(int type, int id, int size, int align)
+{
+    traceop_t op;
+
+    if (type == FREE)
+	live_bytes -= sizes[id];
+    else {
+	live_bytes += size - ((type == REALLOC) ? sizes[id] : 0);
+	sizes[id] = size;
+	if (live_bytes > peak_bytes)
+	    peak_bytes = live_bytes;
+    }
+
+    if (binary) {
+	op.type = type;
+	op.index = id;
+	op.size = (type == FREE) ? 0 : size;
+	op.align = align;
+	if (fwrite(&op, sizeof(op), 1, out) != 1)
+	    die(strerror(errno));
+    }
+    else if (type == FREE)
+	fprintf(out, "f %d\n", id);
+    else if (type == MEMALIGN)
+	fprintf(out, "m %d %d %d\n", id, align, size);
+    else
+	fprintf(out, "%c %d %d\n", (type == ALLOC) ? 'a' : 'r', id, size);
+    ops++;
+}
+
+/*
+ * write_header - Write the trace header at the start of the output.
+ *     The text header is padded to a fixed width so that the final one
+ *     overwrites the placeholder exactly.
+ */
+static void write_header(void)
+{
+    tracehdr_t hdr;
+    long long heap = (peak_bytes > INT_MAX) ? INT_MAX : peak_bytes;
+
+    if (ops > INT_MAX)
+	die("too many requests for the trace format");
+    if (fseek(out, 0, SEEK_SET) < 0)
+	die(strerror(errno));
+    if (binary) {
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = TRACE_MAGIC;
+	hdr.version = TRACE_VERSION;
+	hdr.sugg_heapsize = heap;
+	hdr.num_ids = next_id;
+	hdr.num_ops = ops;
+	hdr.weight = 1;
+	if (fwrite(&hdr, sizeof(hdr), 1, out) != 1)
+	    die(strerror(errno));
+    }
+    else
+	fprintf(out, "%10lld\n%10d\n%10lld\n%10d\n", heap, next_id, ops, 1);
+    if (fseek(out, 0, SEEK_END) < 0)
+	die(strerror(errno));
+}
+
+/*
+ * uniform01 - Return a pseudo-random number in [0, 1), from a
+ *     xorshift64* generator so traces are the same on every platform
+ */
+static double uniform01(void)
+{
+    seed ^= seed >> 12;
+    seed ^= seed << 25;
+    seed ^= seed >> 27;
+    return ((seed * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / (1ULL << 53));
+}
+
+/*
+ * parse_model - Parse "name[,arg...]" into one of nnames model names
+ *     and up to nargs numeric arguments
+ */
+static void parse_model(char *arg, char **names, int nnames, int *model,
+			double *args, int nargs)
+{
+    char buf[MAXLINE], *tok;
+    int i;
+
+    strncpy(buf, arg, MAXLINE - 1);
+    buf[MAXLINE - 1] = '\0';
+    tok = strtok(buf, ",");
+    for (i = 0; i < nnames; i++)
+	if (tok != NULL && strcmp(tok, names[i]) == 0)
+	    break;
+    if (i == nnames) {
+	fprintf(stderr, "tracegen: unknown model %s\n", arg);
+	exit(1);
+    }
+    *model = i;
+    for (i = 0; (tok = strtok(NULL, ",")) != NULL; i++) {
+	if (i == nargs) {
+	    fprintf(stderr, "tracegen: too many parameters in %s\n", arg);
+	    exit(1);
+	}
+	args[i] = strtod(tok, NULL);
+    }
+}
+
+/*
+ * grow_array - Grow array p of elt-byte elements, with capacity *cap,
+ *     to hold at least need elements
+ */
+static void *grow_array(void *p, long *cap, long need, size_t elt)
+{
+    if (need <= *cap)
+	return p;
+    *cap = (*cap < 1024) ? 1024 : 2 * *cap;
+    if (*cap < need)
+	*cap = need;
+    if ((p = realloc(p, *cap * elt)) == NULL)
+	die("out of memory");
+    return p;
+}
+
+static void usage(char *prog)
+{
+    fprintf(stderr, "Usage: %s [-bh] [-n <ops>] [-w <blocks>] [-s <sizes>] "
+	    "[-l <lifetimes>]\n", prog);
+    fprintf(stderr, "          [-r <pct>] [-g <growth>] [-M <bytes>] "
+	    "[-a <pct>]\n");
+    fprintf(stderr, "          [-A <bytes>] [-S <seed>] <outfile>\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-b             Write the binary trace format.\n");
+    fprintf(stderr, "\t-h             Print this message.\n");
+    fprintf(stderr, "\t-n <ops>       Number of requests (default 1e5).\n");
+    fprintf(stderr, "\t-w <blocks>    Live blocks to hover around "
+	    "(default 1000).\n");
+    fprintf(stderr, "\t-s uniform,LO,HI      Sizes uniform in [LO,HI] "
+	    "(default 16..512).\n");
+    fprintf(stderr, "\t-s power,LO,HI,A      Sizes in [LO,HI] with "
+	    "density ~ size^-A.\n");
+    fprintf(stderr, "\t-s bimodal,LO,HI,P    Sizes near LO with "
+	    "probability P, else near HI.\n");
+    fprintf(stderr, "\t-l lifo|fifo|random   Which block each free "
+	    "hits (default random).\n");
+    fprintf(stderr, "\t-l long,F             Random, but a fraction F of "
+	    "the blocks live forever.\n");
+    fprintf(stderr, "\t-r <pct>       Percentage of requests that are "
+	    "reallocs (default 0).\n");
+    fprintf(stderr, "\t-g geom,F|linear,N|random  Realloc to F times the "
+	    "size (default 1.5),\n");
+    fprintf(stderr, "\t               N bytes more (default 64), or a "
+	    "fresh size.\n");
+    fprintf(stderr, "\t-M <bytes>     Largest size a realloc grows to "
+	    "(default 1M).\n");
+    fprintf(stderr, "\t-a <pct>       Percentage of allocations that are "
+	    "memaligns (default 0).\n");
+    fprintf(stderr, "\t-A <bytes>     Largest memalign alignment "
+	    "(default 4096).\n");
+    fprintf(stderr, "\t-S <seed>      Random seed (default 1).\n");
+}
+
+/*
+ * die - Report an error, remove the partial output, and exit
+ */
+static void die(char *msg)
+{
+    fprintf(stderr, "tracegen: %s\n", msg);
+    if (outpath != NULL)
+	remove(outpath);
+    exit(1);
+}